@@ -0,0 +1,136 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/async_log.h"
+#include "../src/logger.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+namespace http = boost::beast::http;
+
+constexpr int REQUESTS_PER_SECOND = 50'000;
+constexpr int THREADS = 4;
+constexpr std::chrono::milliseconds SLICE = 10ms;
+constexpr std::chrono::milliseconds RUN_TIME = 2s;
+constexpr int REQUESTS_PER_SLICE = REQUESTS_PER_SECOND / THREADS * SLICE.count() / 1000;
+constexpr int TOTAL_REQUESTS = REQUESTS_PER_SLICE * THREADS * (RUN_TIME / SLICE);
+
+constexpr std::string_view CLIENT_IP = "192.168.100.200";
+constexpr std::string_view URI = "/api/v1/game/state";
+constexpr std::string_view CONTENT_TYPE = "application/json";
+
+// вывод выбрасывается: измеряется работа журнала, а не терминала
+class NullBuffer : public std::streambuf {
+protected:
+    std::streamsize xsputn(const char*, std::streamsize size) override {
+        return size;
+    }
+
+    int overflow(int c) override {
+        return traits_type::not_eof(c);
+    }
+};
+
+// так журнал писался раньше: два json::value на запрос и синхронный вывод через Boost.Log
+void LogSync() {
+    boost::json::value request = {
+        {"ip", CLIENT_IP},
+        {"URI", URI},
+        {"method", http::to_string(http::verb::get)}
+    };
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(http_logger::log_data, request) << "request received";
+    boost::json::value response = {
+        {"response_time", 0},
+        {"code", 200},
+        {"content_type", CONTENT_TYPE}
+    };
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(http_logger::log_data, response) << "response sent";
+}
+
+void LogAsync(http_logger::AsyncLog& log) {
+    if (log.Sample()) {
+        log.LogRequest(CLIENT_IP, URI, http::verb::get);
+        log.LogResponse(0, 200, CONTENT_TYPE);
+    }
+}
+
+/* REQUESTS_PER_SECOND запросов в секунду на THREADS потоках, каждый поток раз в SLICE пишет свою долю.
+   Возвращает суммарное время, которое потоки запросов провели в журнале
+ */
+template <typename Fn>
+std::chrono::nanoseconds RunAtRate(const Fn& log_request) {
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<std::int64_t> spent{0};
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < THREADS; ++thread) {
+        threads.emplace_back([&spent, &log_request] {
+            Clock::duration local = Clock::duration::zero();
+            auto next_slice = Clock::now();
+            for (auto slice = 0; slice < RUN_TIME / SLICE; ++slice) {
+                const auto start = Clock::now();
+                for (int i = 0; i < REQUESTS_PER_SLICE; ++i) {
+                    log_request();
+                }
+                local += Clock::now() - start;
+                next_slice += SLICE;
+                std::this_thread::sleep_until(next_slice);
+            }
+            spent += std::chrono::duration_cast<std::chrono::nanoseconds>(local).count();
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return std::chrono::nanoseconds{spent.load()};
+}
+
+void Report(std::string_view name, std::chrono::nanoseconds spent) {
+    const double per_request = static_cast<double>(spent.count()) / TOTAL_REQUESTS;
+    // доля одного ядра, которую журнал отнимает у потоков запросов при заданной нагрузке
+    const double core_share = per_request * REQUESTS_PER_SECOND / 1e9 * 100;
+    std::cout << name << ": " << per_request << " ns per request, " << core_share << "% of a core\n";
+}
+
+} // namespace
+
+TEST_CASE("Access log: request thread time at 50k requests per second", "[!benchmark][access log]") {
+    NullBuffer null_buffer;
+    std::ostream null_stream{&null_buffer};
+
+    auto sink = logging::add_console_log(
+        null_stream,
+        keywords::format = &http_logger::LogFormatter,
+        keywords::auto_newline_mode = logging::sinks::auto_newline_mode::disabled_auto_newline,
+        keywords::auto_flush = true
+    );
+    logging::add_common_attributes();
+    const auto sync_spent = RunAtRate(LogSync);
+    logging::core::get()->remove_sink(sink);
+
+    http_logger::AsyncLog log{null_stream};
+    const auto async_spent = RunAtRate([&log] {
+        LogAsync(log);
+    });
+    log.Stop();
+
+    http_logger::AsyncLog sampled_log{null_stream, {.sample_rate = 10}};
+    const auto sampled_spent = RunAtRate([&sampled_log] {
+        LogAsync(sampled_log);
+    });
+    sampled_log.Stop();
+
+    Report("before: Boost.Log on the request thread"sv, sync_spent);
+    Report("after: records in per-thread rings"sv, async_spent);
+    Report("after: rings, one request in 10"sv, sampled_spent);
+    std::cout << "dropped records: " << log.GetDropped() << " of all requests, "
+              << sampled_log.GetDropped() << " of one in 10\n";
+}
@@ -0,0 +1,88 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/api_router.h"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+using http_handler::MethodMask;
+using http_handler::Route;
+using http_handler::RouteTable;
+
+namespace {
+
+namespace http = boost::beast::http;
+
+constexpr size_t LOOKUPS = 10'000;
+
+// N ресурсов вида /api/v1/resource<i>/{id}; шаблоны живут в patterns, таблица ссылается на них
+template <size_t N>
+std::unique_ptr<RouteTable<size_t, N>> MakeRouteTable(std::vector<std::string>& patterns) {
+    patterns.clear();
+    for (size_t i = 0; i < N; ++i) {
+        patterns.push_back("/api/v1/resource"s + std::to_string(i) + "/{id}"s);
+    }
+
+    std::array<Route<size_t>, N> routes;
+    for (size_t i = 0; i < N; ++i) {
+        routes[i] = Route<size_t>{patterns[i], i, MethodMask{http::verb::get}};
+    }
+    return std::make_unique<RouteTable<size_t, N>>(routes);
+}
+
+// прежняя схема: цепочка сравнений префиксов, последний маршрут проверяется последним
+size_t FindByPrefixChain(const std::vector<std::string>& prefixes, std::string_view target) {
+    for (size_t i = 0; i < prefixes.size(); ++i) {
+        const std::string& prefix = prefixes[i];
+        if (target.substr(0, prefix.size()) == prefix
+            && target.size() > prefix.size() && target[prefix.size()] == '/') {
+            return i;
+        }
+    }
+    return prefixes.size();
+}
+
+template <size_t N>
+void BenchmarkRoutes() {
+    std::vector<std::string> patterns;
+    auto table = MakeRouteTable<N>(patterns);
+
+    std::vector<std::string> prefixes;
+    for (size_t i = 0; i < N; ++i) {
+        prefixes.push_back("/api/v1/resource"s + std::to_string(i));
+    }
+
+    const std::string target = "/api/v1/resource"s + std::to_string(N - 1) + "/42"s;
+    REQUIRE(table->Find(target).route->endpoint == N - 1);
+    REQUIRE(table->Find(target).params[0] == "42"sv);
+    REQUIRE(FindByPrefixChain(prefixes, target) == N - 1);
+
+    BENCHMARK("prefix chain, "s + std::to_string(N) + " routes"s) {
+        size_t found = 0;
+        for (size_t i = 0; i < LOOKUPS; ++i) {
+            found += FindByPrefixChain(prefixes, target);
+        }
+        return found;
+    };
+
+    BENCHMARK("route table, "s + std::to_string(N) + " routes"s) {
+        size_t found = 0;
+        for (size_t i = 0; i < LOOKUPS; ++i) {
+            found += table->Find(target).route->endpoint;
+        }
+        return found;
+    };
+}
+
+} // namespace
+
+TEST_CASE("Routing the last registered endpoint, 10k lookups", "[!benchmark][api router]") {
+    BenchmarkRoutes<8>();
+    BenchmarkRoutes<64>();
+    BenchmarkRoutes<512>();
+}
@@ -0,0 +1,88 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/collision_detector.h"
+
+#include <random>
+#include <vector>
+
+using namespace collision_detector;
+
+namespace {
+
+class VectorProvider : public ItemGathererProvider {
+public:
+    size_t ItemsCount() const override {
+        return items.size();
+    }
+
+    Item GetItem(size_t idx) const override {
+        return items[idx];
+    }
+
+    size_t GatherersCount() const override {
+        return gatherers.size();
+    }
+
+    Gatherer GetGatherer(size_t idx) const override {
+        return gatherers[idx];
+    }
+
+    std::vector<Item> items;
+    std::vector<Gatherer> gatherers;
+};
+
+// собаки (ширина 0.3) делают шаг одного тика вдоль оси, предметы (ширина 0) и офисы (0.25)
+// разбросаны по квадрату side x side
+VectorProvider MakeSession(size_t gatherers_count, size_t items_count, double side) {
+    std::mt19937 generator{42};
+    std::uniform_real_distribution<double> coord(0., side);
+    std::uniform_real_distribution<double> step(-0.1, 0.1);
+
+    VectorProvider provider;
+    for (size_t i = 0; i < items_count; ++i) {
+        provider.items.push_back({{coord(generator), coord(generator)}, i % 10 == 0 ? 0.25 : 0.});
+    }
+    for (size_t g = 0; g < gatherers_count; ++g) {
+        geom::Point2D start{coord(generator), coord(generator)};
+        geom::Point2D end = start;
+        (g % 2 == 0 ? end.x : end.y) += step(generator);
+        provider.gatherers.push_back({start, end, 0.3});
+    }
+    return provider;
+}
+
+bool IsSameEvents(const std::vector<GatheringEvent>& lhs, const std::vector<GatheringEvent>& rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const auto& l, const auto& r) {
+        return l.item_id == r.item_id && l.gatherer_id == r.gatherer_id
+            && l.sq_distance == r.sq_distance && l.time == r.time;
+    });
+}
+
+} // namespace
+
+TEST_CASE("Gather events for hundreds of dogs and loot items", "[!benchmark][collision detector]") {
+    const VectorProvider provider = MakeSession(500, 500, 100.);
+    REQUIRE(IsSameEvents(FindGatherEvents(provider), FindGatherEventsBruteForce(provider)));
+
+    BENCHMARK("brute force, 500 dogs x 500 items") {
+        return FindGatherEventsBruteForce(provider).size();
+    };
+
+    BENCHMARK("uniform grid, 500 dogs x 500 items") {
+        return FindGatherEvents(provider).size();
+    };
+}
+
+TEST_CASE("Gather events in a crowded session", "[!benchmark][collision detector]") {
+    const VectorProvider provider = MakeSession(2'000, 2'000, 200.);
+    REQUIRE(IsSameEvents(FindGatherEvents(provider), FindGatherEventsBruteForce(provider)));
+
+    BENCHMARK("brute force, 2k dogs x 2k items") {
+        return FindGatherEventsBruteForce(provider).size();
+    };
+
+    BENCHMARK("uniform grid, 2k dogs x 2k items") {
+        return FindGatherEvents(provider).size();
+    };
+}
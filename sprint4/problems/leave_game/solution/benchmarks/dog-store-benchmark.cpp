@@ -0,0 +1,83 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/model.h"
+
+#include <memory>
+#include <unordered_map>
+
+using namespace model;
+using namespace std::literals;
+
+namespace {
+
+// Прежняя раскладка: каждая собака - отдельный объект в куче,
+// сессия хранит unordered_map<Id, shared_ptr<Dog>> и копирует shared_ptr при обходе
+struct LegacyDog {
+    geom::Point2D pos;
+    geom::Point2D prev_pos;
+    geom::Vec2D speed;
+    Direction dir = Direction::NORTH;
+    game_obj::Bag<Loot> bag{3};
+    std::uint16_t score = 0;
+    std::string name;
+};
+
+using LegacyDogs = std::unordered_map<std::uint32_t, std::shared_ptr<LegacyDog>>;
+
+constexpr size_t DOGS_COUNT = 10'000;
+constexpr double TICK_MULTY = 0.02;
+
+geom::Vec2D MakeSpeed(size_t i) {
+    return i % 2 == 0 ? geom::Vec2D{1., 0.} : geom::Vec2D{0., -1.};
+}
+
+} // namespace
+
+TEST_CASE("Dogs integration step: legacy map vs struct of arrays", "[!benchmark][dog store]") {
+    LegacyDogs legacy_dogs;
+    auto store = std::make_shared<DogStore>();
+    for (size_t i = 0; i < DOGS_COUNT; ++i) {
+        auto dog = std::make_shared<LegacyDog>();
+        dog->speed = MakeSpeed(i);
+        legacy_dogs.emplace(static_cast<std::uint32_t>(i), std::move(dog));
+        store->Add({0., 0.}, MakeSpeed(i), 3);
+    }
+
+    BENCHMARK("before: unordered_map<Id, shared_ptr<Dog>>, 10k dogs") {
+        for (auto [_, dog] : legacy_dogs) {
+            dog->prev_pos = dog->pos;
+            dog->pos = {dog->pos.x + dog->speed.x * TICK_MULTY, dog->pos.y + dog->speed.y * TICK_MULTY};
+        }
+        return legacy_dogs.size();
+    };
+
+    BENCHMARK("after: DogStore dense arrays, 10k dogs") {
+        auto& positions = store->GetPositions();
+        auto& prev_positions = store->GetPreviousPositions();
+        const auto& speeds = store->GetSpeeds();
+        for (size_t i = 0; i < store->Size(); ++i) {
+            prev_positions[i] = positions[i];
+            positions[i].x += speeds[i].x * TICK_MULTY;
+            positions[i].y += speeds[i].y * TICK_MULTY;
+        }
+        return store->Size();
+    };
+}
+
+TEST_CASE("Game session tick with 10k dogs on one long road", "[!benchmark][dog store]") {
+    Map map{Map::Id{"road"s}, "Road"s};
+    map.AddRoad({Road::HORIZONTAL, {0, 0}, 100'000});
+    GameSession session{&map, false, LootConfig{}};
+
+    for (size_t i = 0; i < DOGS_COUNT; ++i) {
+        Dog* dog = session.AddDog("dog"sv);
+        dog->SetSpeed({1., 0.});
+        dog->SetDirection(Direction::EAST);
+    }
+
+    BENCHMARK("UpdateState, 10k dogs, 20 ms tick") {
+        session.UpdateState(20);
+        return session.GetDogStore().Size();
+    };
+}
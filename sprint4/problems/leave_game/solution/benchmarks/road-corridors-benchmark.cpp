@@ -0,0 +1,71 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/model.h"
+
+#include <random>
+
+using namespace model;
+using namespace std::literals;
+
+namespace {
+
+// Карта-решетка: каждая клетка 10x10 ограничена короткими дорогами,
+// при grid_size = 71 на карте получается 10224 дороги
+Map MakeLatticeMap(int grid_size) {
+    Map map{Map::Id{"lattice"s}, "Lattice"s};
+    map.SetDogSpeed(1.);
+    constexpr int cell = 10;
+    for (int i = 0; i <= grid_size; ++i) {
+        for (int j = 0; j < grid_size; ++j) {
+            map.AddRoad({Road::HORIZONTAL, {j * cell, i * cell}, (j + 1) * cell});
+            map.AddRoad({Road::VERTICAL, {i * cell, j * cell}, (j + 1) * cell});
+        }
+    }
+    return map;
+}
+
+void RunAllDogs(GameSession& session, std::mt19937& generator) {
+    std::uniform_int_distribution<int> dir_dist(0, 3);
+    for (const auto& [_, dog] : session.GetDogs()) {
+        switch (dir_dist(generator)) {
+            case 0:
+                dog->SetSpeed({0, -1.});
+                dog->SetDirection(Direction::NORTH);
+                break;
+            case 1:
+                dog->SetSpeed({0, 1.});
+                dog->SetDirection(Direction::SOUTH);
+                break;
+            case 2:
+                dog->SetSpeed({-1., 0});
+                dog->SetDirection(Direction::WEST);
+                break;
+            default:
+                dog->SetSpeed({1., 0});
+                dog->SetDirection(Direction::EAST);
+                break;
+        }
+    }
+}
+
+} // namespace
+
+TEST_CASE("Dogs movement on a map with 10k+ roads", "[!benchmark][road corridors]") {
+    Game game;
+    game.AddMap(MakeLatticeMap(71));
+    game.TurnOnRandomSpawn();
+    GameSession& session = game.StartGameSession(game.FindMap(Map::Id{"lattice"s}));
+
+    for (int i = 0; i < 10'000; ++i) {
+        session.AddDog("dog"sv);
+    }
+
+    std::mt19937 generator{42};
+    BENCHMARK_ADVANCED("UpdateState, 10k dogs, 20 ms tick")(Catch::Benchmark::Chronometer meter) {
+        RunAllDogs(session, generator);
+        meter.measure([&session] {
+            session.UpdateState(20);
+        });
+    };
+}
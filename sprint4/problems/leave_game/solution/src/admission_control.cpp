@@ -0,0 +1,101 @@
+#include "admission_control.h"
+
+#include "logger.h"
+
+#include <chrono>
+#include <string_view>
+
+namespace http_server {
+
+AdmissionControl::Ticket::Ticket(std::shared_ptr<AdmissionControl> owner, const net::ip::address& address)
+    : owner_(std::move(owner))
+    , address_(address) {
+}
+
+AdmissionControl::Ticket::~Ticket() {
+    if (owner_) {
+        owner_->Release(address_);
+    }
+}
+
+std::size_t AdmissionControl::AddressHasher::operator()(const net::ip::address& address) const noexcept {
+    if (address.is_v4()) {
+        return std::hash<net::ip::address_v4::uint_type>{}(address.to_v4().to_uint());
+    }
+    const auto bytes = address.to_v6().to_bytes();
+    return std::hash<std::string_view>{}(std::string_view{reinterpret_cast<const char*>(bytes.data()), bytes.size()});
+}
+
+AdmissionControl::AdmissionControl(AdmissionLimits limits, OverloadCheck is_overloaded)
+    : limits_(limits)
+    , is_overloaded_(std::move(is_overloaded)) {
+}
+
+std::optional<AdmissionControl::Ticket> AdmissionControl::Admit(const net::ip::address& address) {
+    std::atomic<std::uint64_t>* rejected = nullptr;
+    if (is_overloaded_ && is_overloaded_()) {
+        rejected = &rejected_overload_;
+    } else {
+        std::lock_guard lock{mutex_};
+        if (limits_.max_connections != 0 && active_ >= limits_.max_connections) {
+            rejected = &rejected_connections_;
+        } else if (std::size_t& count = connections_by_ip_[address];
+                   limits_.max_connections_per_ip != 0 && count >= limits_.max_connections_per_ip) {
+            rejected = &rejected_per_ip_;
+        } else {
+            ++count;
+            ++active_;
+        }
+    }
+
+    if (rejected != nullptr) {
+        rejected->fetch_add(1, std::memory_order_relaxed);
+        ReportShedding();
+        return std::nullopt;
+    }
+    accepted_.fetch_add(1, std::memory_order_relaxed);
+    return Ticket{shared_from_this(), address};
+}
+
+void AdmissionControl::OnAcceptError() {
+    accept_errors_.fetch_add(1, std::memory_order_relaxed);
+}
+
+AdmissionStats AdmissionControl::GetStats() const {
+    AdmissionStats stats;
+    {
+        std::lock_guard lock{mutex_};
+        stats.active = active_;
+    }
+    stats.accepted = accepted_.load(std::memory_order_relaxed);
+    stats.rejected_connections = rejected_connections_.load(std::memory_order_relaxed);
+    stats.rejected_per_ip = rejected_per_ip_.load(std::memory_order_relaxed);
+    stats.rejected_overload = rejected_overload_.load(std::memory_order_relaxed);
+    stats.accept_errors = accept_errors_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AdmissionControl::Release(const net::ip::address& address) {
+    std::lock_guard lock{mutex_};
+    --active_;
+    if (auto it = connections_by_ip_.find(address); it != connections_by_ip_.end() && --it->second == 0) {
+        connections_by_ip_.erase(it);
+    }
+}
+
+void AdmissionControl::ReportShedding() {
+    using namespace std::chrono;
+
+    const std::int64_t now = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    std::int64_t last_report = last_report_ms_.load(std::memory_order_relaxed);
+    if (now - last_report < REPORT_PERIOD_MS
+        || !last_report_ms_.compare_exchange_strong(last_report, now, std::memory_order_relaxed)) {
+        return;
+    }
+
+    const AdmissionStats stats = GetStats();
+    http_logger::LogConnectionsShed(stats.accepted, stats.active, stats.rejected_connections,
+                                    stats.rejected_per_ip, stats.rejected_overload, stats.accept_errors);
+}
+
+}  // namespace http_server
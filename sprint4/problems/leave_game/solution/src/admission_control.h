@@ -0,0 +1,95 @@
+#pragma once
+
+#include <boost/asio/ip/address.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace http_server {
+
+namespace net = boost::asio;
+
+struct AdmissionLimits {
+    // 0 - без ограничения
+    std::size_t max_connections = 0;
+    std::size_t max_connections_per_ip = 0;
+};
+
+struct AdmissionStats {
+    std::uint64_t accepted = 0;
+    std::uint64_t active = 0;
+    std::uint64_t rejected_connections = 0;
+    std::uint64_t rejected_per_ip = 0;
+    std::uint64_t rejected_overload = 0;
+    std::uint64_t accept_errors = 0;
+};
+
+/* Решает, обслуживать ли новое соединение. Отказ дешевый: сессия не создается, запрос не читается,
+   клиент получает готовый ответ 503. Счетчики можно читать из любого потока
+ */
+class AdmissionControl : public std::enable_shared_from_this<AdmissionControl> {
+public:
+    // true - сервер не успевает (например, очередь strand игры или отставание тиков), новых клиентов не берем
+    using OverloadCheck = std::function<bool()>;
+
+    constexpr static std::int64_t REPORT_PERIOD_MS = 1000;
+
+    // место, занятое соединением; освобождается вместе с ним
+    class Ticket {
+    public:
+        Ticket() = default;
+        Ticket(Ticket&&) noexcept = default;
+        Ticket& operator=(Ticket&&) = delete;
+        ~Ticket();
+
+    private:
+        friend class AdmissionControl;
+
+        Ticket(std::shared_ptr<AdmissionControl> owner, const net::ip::address& address);
+
+        std::shared_ptr<AdmissionControl> owner_;
+        net::ip::address address_;
+    };
+
+    explicit AdmissionControl(AdmissionLimits limits, OverloadCheck is_overloaded = {});
+
+    AdmissionControl(const AdmissionControl&) = delete;
+    AdmissionControl& operator=(const AdmissionControl&) = delete;
+
+    // nullopt - соединение надо отклонить, причина уже учтена в счетчиках
+    std::optional<Ticket> Admit(const net::ip::address& address);
+    void OnAcceptError();
+
+    AdmissionStats GetStats() const;
+
+private:
+    // в этой версии Boost у адреса нет std::hash
+    struct AddressHasher {
+        std::size_t operator()(const net::ip::address& address) const noexcept;
+    };
+
+    AdmissionLimits limits_;
+    OverloadCheck is_overloaded_;
+
+    mutable std::mutex mutex_;
+    std::size_t active_ = 0;
+    std::unordered_map<net::ip::address, std::size_t, AddressHasher> connections_by_ip_;
+
+    std::atomic<std::uint64_t> accepted_{0};
+    std::atomic<std::uint64_t> rejected_connections_{0};
+    std::atomic<std::uint64_t> rejected_per_ip_{0};
+    std::atomic<std::uint64_t> rejected_overload_{0};
+    std::atomic<std::uint64_t> accept_errors_{0};
+    std::atomic<std::int64_t> last_report_ms_{0};
+
+    void Release(const net::ip::address& address);
+    // во время наплыва отказов счетчики пишутся в лог не чаще раза в REPORT_PERIOD_MS
+    void ReportShedding();
+};
+
+}  // namespace http_server
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <boost/beast/http/verb.hpp>
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string_view>
+
+namespace http_handler {
+
+namespace http = boost::beast::http;
+
+// множество HTTP-методов: по биту на каждое значение http::verb
+class MethodMask {
+public:
+    constexpr MethodMask() = default;
+
+    constexpr MethodMask(std::initializer_list<http::verb> verbs) {
+        for (http::verb verb : verbs) {
+            bits_ |= Bit(verb);
+        }
+    }
+
+    constexpr bool Contains(http::verb verb) const noexcept {
+        return (bits_ & Bit(verb)) != 0;
+    }
+
+private:
+    static_assert(static_cast<unsigned>(http::verb::unlink) < 64, "http::verb does not fit into the mask");
+
+    std::uint64_t bits_ = 0;
+
+    constexpr static std::uint64_t Bit(http::verb verb) noexcept {
+        return std::uint64_t{1} << static_cast<unsigned>(verb);
+    }
+};
+
+/* Маршрут: путь из сегментов через '/', сегмент вида {name} совпадает с любым непустым сегментом
+   и попадает в параметры. Точный сегмент важнее параметра на том же уровне
+ */
+template <typename Endpoint>
+struct Route {
+    std::string_view pattern;
+    Endpoint endpoint;
+    MethodMask methods;
+};
+
+template <typename Endpoint>
+struct RouteMatch {
+    constexpr static size_t MAX_PARAMS = 4;
+
+    const Route<Endpoint>* route = nullptr;
+    std::array<std::string_view, MAX_PARAMS> params{};
+    size_t params_count = 0;
+
+    constexpr explicit operator bool() const noexcept {
+        return route != nullptr;
+    }
+};
+
+/* Префиксное дерево по сегментам пути, строится на этапе компиляции.
+   Переход к ребенку ищется в одной хеш-таблице по паре (узел, сегмент), поэтому поиск
+   стоит O(число сегментов) и не зависит от того, сколько маршрутов в таблице.
+   Строка запроса и завершающий '/' игнорируются
+ */
+template <typename Endpoint, size_t N>
+class RouteTable {
+public:
+    constexpr static size_t MAX_SEGMENTS = 8;
+
+    constexpr explicit RouteTable(const std::array<Route<Endpoint>, N>& routes)
+        : routes_(routes) {
+        for (size_t route = 0; route < N; ++route) {
+            AddRoute(route);
+        }
+    }
+
+    constexpr RouteMatch<Endpoint> Find(std::string_view target) const noexcept {
+        RouteMatch<Endpoint> match;
+
+        std::string_view path = target.substr(0, target.find('?'));
+        if (path.empty() || path.front() != '/') {
+            return match;
+        }
+        path.remove_prefix(1);
+        if (!path.empty() && path.back() == '/') {
+            path.remove_suffix(1);
+        }
+
+        std::uint32_t node = ROOT;
+        while (!path.empty()) {
+            const size_t slash = path.find('/');
+            const std::string_view segment = path.substr(0, slash);
+            path = slash == std::string_view::npos ? std::string_view{} : path.substr(slash + 1);
+
+            std::uint32_t child = FindChild(node, segment);
+            if (child == NO_NODE) {
+                child = nodes_[node].param_child;
+                if (child == NO_NODE || segment.empty() || match.params_count == match.MAX_PARAMS) {
+                    return match;
+                }
+                match.params[match.params_count++] = segment;
+            }
+            node = child;
+        }
+
+        if (nodes_[node].route != NO_ROUTE) {
+            match.route = &routes_[nodes_[node].route];
+        } else {
+            match.params_count = 0;
+        }
+        return match;
+    }
+
+    constexpr const std::array<Route<Endpoint>, N>& GetRoutes() const noexcept {
+        return routes_;
+    }
+
+private:
+    constexpr static size_t MAX_NODES = N * MAX_SEGMENTS + 1;
+    constexpr static std::uint32_t ROOT = 0;
+    constexpr static std::uint32_t NO_NODE = static_cast<std::uint32_t>(MAX_NODES);
+    constexpr static std::uint32_t NO_ROUTE = static_cast<std::uint32_t>(N);
+
+    // не меньше двух слотов на узел: при такой загрузке линейное пробирование почти всегда с первой попытки
+    constexpr static size_t SLOTS = [] {
+        size_t slots = 1;
+        while (slots < 2 * MAX_NODES) {
+            slots *= 2;
+        }
+        return slots;
+    }();
+
+    struct Node {
+        std::uint32_t param_child = NO_NODE;
+        std::uint32_t route = NO_ROUTE;
+    };
+
+    struct Edge {
+        std::uint32_t parent = NO_NODE;
+        std::uint32_t child = NO_NODE;
+        std::string_view segment;
+    };
+
+    std::array<Route<Endpoint>, N> routes_;
+    std::array<Node, MAX_NODES> nodes_{};
+    std::array<Edge, SLOTS> edges_{};
+    std::uint32_t nodes_count_ = 1;
+
+    constexpr static size_t Hash(std::uint32_t parent, std::string_view segment) noexcept {
+        // FNV-1a: годится и для constexpr, и для коротких сегментов пути
+        std::uint64_t hash = 14695981039346656037ull ^ parent;
+        for (char c : segment) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return static_cast<size_t>(hash ^ (hash >> 32)) & (SLOTS - 1);
+    }
+
+    constexpr std::uint32_t FindChild(std::uint32_t parent, std::string_view segment) const noexcept {
+        for (size_t slot = Hash(parent, segment);; slot = (slot + 1) & (SLOTS - 1)) {
+            const Edge& edge = edges_[slot];
+            if (edge.parent == NO_NODE) {
+                return NO_NODE;
+            }
+            if (edge.parent == parent && edge.segment == segment) {
+                return edge.child;
+            }
+        }
+    }
+
+    constexpr std::uint32_t NewNode() {
+        if (nodes_count_ == MAX_NODES) {
+            throw std::length_error("Route pattern has too many segments");
+        }
+        return nodes_count_++;
+    }
+
+    constexpr std::uint32_t AddChild(std::uint32_t parent, std::string_view segment) {
+        if (segment.size() > 2 && segment.front() == '{' && segment.back() == '}') {
+            if (nodes_[parent].param_child == NO_NODE) {
+                nodes_[parent].param_child = NewNode();
+            }
+            return nodes_[parent].param_child;
+        }
+
+        size_t slot = Hash(parent, segment);
+        for (; edges_[slot].parent != NO_NODE; slot = (slot + 1) & (SLOTS - 1)) {
+            if (edges_[slot].parent == parent && edges_[slot].segment == segment) {
+                return edges_[slot].child;
+            }
+        }
+        edges_[slot] = Edge{parent, NewNode(), segment};
+        return edges_[slot].child;
+    }
+
+    constexpr void AddRoute(size_t route) {
+        std::string_view path = routes_[route].pattern;
+        if (path.empty() || path.front() != '/') {
+            throw std::invalid_argument("Route pattern must start with '/'");
+        }
+        path.remove_prefix(1);
+
+        std::uint32_t node = ROOT;
+        while (!path.empty()) {
+            const size_t slash = path.find('/');
+            const std::string_view segment = path.substr(0, slash);
+            if (segment.empty()) {
+                throw std::invalid_argument("Route pattern has an empty segment");
+            }
+            node = AddChild(node, segment);
+            path = slash == std::string_view::npos ? std::string_view{} : path.substr(slash + 1);
+        }
+
+        if (nodes_[node].route != NO_ROUTE) {
+            throw std::invalid_argument("Route pattern is registered twice");
+        }
+        nodes_[node].route = static_cast<std::uint32_t>(route);
+    }
+};
+
+}  // namespace http_handler
@@ -33,7 +33,7 @@ std::string ListPlayersError::what() const {
 }
 
 const model::GameSession::IdToDogIndex& GetPlayersInfoUseCase::GetPlayersList(std::string_view token) const {
-    const user::Player* player = tokens_->FindPlayerByToken(user::Token{std::string(token)});
+    const user::Player* player = tokens_->FindPlayerByToken(token);
     if (player == nullptr) {
         throw ListPlayersError{ListPlayersErrorReason::unknownToken};
     }
@@ -41,11 +41,11 @@ const model::GameSession::IdToDogIndex& GetPlayersInfoUseCase::GetPlayersList(st
 }
 
 const model::GameSession* GetPlayersInfoUseCase::GetPlayerGameSession(std::string_view token) const {
-    const user::Player* player = tokens_->FindPlayerByToken(user::Token{std::string(token)});
+    const user::Player* player = tokens_->FindPlayerByToken(token);
     if (player == nullptr) {
         throw ListPlayersError{ListPlayersErrorReason::unknownToken};
     }
-    return tokens_->FindPlayerByToken(user::Token{std::string(token)})->GetGameSession();
+    return player->GetGameSession();
 }
 
 std::string JoinGameError::what() const {
@@ -69,10 +69,7 @@ JoinGameResult JoinGameUseCase::JoinGame(const std::string& user_name, const std
         throw JoinGameError{JoinGameErrorReason::invalidMap};
     }
 
-    model::GameSession* session = game_->GetGameSession(model::Map::Id{map_id});
-    if (session == nullptr) {
-        session = &game_->StartGameSession(map);
-    }
+    model::GameSession* session = &game_->GetSessionForNewPlayer(map);
 
     model::Dog* dog = session->AddDog(user_name);
     user::Token player_token = tokens_->AddPlayer(&players_->Add(dog, session));
@@ -80,45 +77,52 @@ JoinGameResult JoinGameUseCase::JoinGame(const std::string& user_name, const std
     return {player_token, dog->GetId()};
 }
 
-bool ManageDogActionsUseCase::MoveDog(std::string_view token, std::string_view move) {
-    user::Player* player = tokens_->FindPlayerByToken(user::Token{std::string(token)});
-    if (player == nullptr) {
-        throw ListPlayersError{ListPlayersErrorReason::unknownToken};
-    }
-
-    double map_speed = player->GetGameSession()->GetMap()->GetSpeed();
-    model::Dog* dog = player->GetDog();
-
+std::optional<model::DogCommand> ParseDogCommand(model::Dog::Id dog_id, std::string_view move) {
     if (move.empty()) {
-        dog->Stop();
+        return model::DogCommand{dog_id, std::nullopt};
     } else if (move == "L"sv) {
-        dog->SetSpeed({-map_speed, 0});
-        dog->SetDirection(model::Direction::WEST);
+        return model::DogCommand{dog_id, model::Direction::WEST};
     } else if (move == "R"sv) {
-        dog->SetSpeed({map_speed, 0});
-        dog->SetDirection(model::Direction::EAST);
+        return model::DogCommand{dog_id, model::Direction::EAST};
     } else if (move == "U"sv) {
-        dog->SetSpeed({0, -map_speed});
-        dog->SetDirection(model::Direction::NORTH);
+        return model::DogCommand{dog_id, model::Direction::NORTH};
     } else if (move == "D"sv) {
-        dog->SetSpeed({0, map_speed});
-        dog->SetDirection(model::Direction::SOUTH);
-    } else {
+        return model::DogCommand{dog_id, model::Direction::SOUTH};
+    }
+    return std::nullopt;
+}
+
+bool ManageDogActionsUseCase::MoveDog(std::string_view token, std::string_view move) {
+    user::Player* player = tokens_->FindPlayerByToken(token);
+    if (player == nullptr) {
+        throw ListPlayersError{ListPlayersErrorReason::unknownToken};
+    }
+    return MoveDog(*player, move);
+}
+
+bool ManageDogActionsUseCase::MoveDog(user::Player& player, std::string_view move) {
+    model::Dog* dog = player.GetDog();
+    auto command = ParseDogCommand(dog->GetId(), move);
+    if (!command) {
         return false;
     }
 
+    dog->Move(command->direction, player.GetGameSession()->GetMap()->GetSpeed());
     return true;
 }
 
-void ProcessTickUseCase::ProcessTick(std::int64_t tick) {
-    game_->UpdateState(tick);
+model::TickReport ProcessTickUseCase::ProcessTick(std::int64_t tick) {
+    return game_->UpdateState(tick);
 }
 
 void DeletePlayerUseCase::DeletePlayer(const std::string& token) {
-    user::Player* player = player_tokens_->FindPlayerByToken(user::Token{token});
-    game_->GetGameSession(player->GetGameSession()->GetMap()->GetId())->DeleteDog(player->GetDog()->GetId());
+    user::Player* player = player_tokens_->FindPlayerByToken(token);
+    const model::GameSession* player_session = player->GetGameSession();
+    const model::Dog::Id dog_id = player->GetDog()->GetId();
+    // индекс игроков ищет запись по собаке, поэтому собака удаляется последней
     players_->Delete(player);
-    player_tokens_->DeletePlayer(user::Token{token});
+    player_tokens_->DeletePlayer(token);
+    game_->GetGameSession(player_session->GetMapId(), player_session->GetId())->DeleteDog(dog_id);
 }
 
 void LeaderboardUseCase::SaveToLeaderboard(const std::string& name, std::uint16_t score, std::uint16_t time_in_game_ms) {
@@ -147,21 +151,54 @@ const model::GameSession::IdToDogIndex& Application::ListPlayers(std::string_vie
 
 JoinGameResult Application::JoinGame(const std::string& user_name, const std::string& map_id) {
     auto join_result = join_game_use_case_.JoinGame(user_name, map_id);
-    NotifyListenersJoin(*join_result.token, tokens_.FindPlayerByToken(join_result.token)->GetDog());
+    ++players_generation_;
+    NotifyListenersJoin(*join_result.token, tokens_.FindPlayerByToken(*join_result.token)->GetDog());
     return join_result;
 }
 
 bool Application::MoveDog(std::string_view token, std::string_view move) {
-    return manage_dog_actions_use_case_.MoveDog(token, move);
+    user::Player* player = tokens_.FindPlayerByToken(token);
+    if (player == nullptr) {
+        throw ListPlayersError{ListPlayersErrorReason::unknownToken};
+    }
+    return MoveDog(*player, move);
 }
 
-void Application::ProcessTick(std::int64_t tick) {
-    NotifyListenersTick(tick);
-    process_tick_use_case_.ProcessTick(tick);
+bool Application::MoveDog(user::Player& player, std::string_view move) {
+    if (!manage_dog_actions_use_case_.MoveDog(player, move)) {
+        return false;
+    }
+    NotifyListenersMove(player.GetDog(), move);
+    return true;
+}
+
+model::TickReport Application::ProcessTick(std::int64_t tick) {
+    using Clock = std::chrono::steady_clock;
+
+    const auto start = Clock::now();
+    // команды применяются до слушателей: те видят собак уже с новыми скоростями
+    game_->ApplyCommands();
+    // слушатели получают то время, которое действительно будет смоделировано
+    const std::int64_t simulated = game_->ClampTickDelta(tick);
+    NotifyListenersTick(simulated);
+    const auto listeners_done = Clock::now();
+    auto report = process_tick_use_case_.ProcessTick(tick);
+    const auto update_done = Clock::now();
+    NotifyListenersTickProcessed(simulated);
+    const auto end = Clock::now();
+
+    last_tick_phases_.update_state = update_done - listeners_done;
+    last_tick_phases_.total = end - start;
+    last_tick_phases_.sessions.clear();
+    if (IsLastTickOverBudget()) {
+        last_tick_phases_.sessions = game_->GetSessionTickTimes();
+    }
+    return report;
 }
 
 void Application::DeletePlayer(const std::string& player_token) {
     delete_player_use_case_.DeletePlayer(player_token);
+    ++players_generation_;
 }
 
 void Application::SaveToLeaderboard(const std::string& name, std::uint16_t score, std::uint16_t time_in_game_ms) {
@@ -172,8 +209,20 @@ std::vector<domain::RetiredPlayer> Application::GetLeaders(size_t start, size_t
     return leaderboard_use_case_.GetLeaders(start, max_players);
 }
 
+std::uint64_t Application::GetPlayersGeneration() const noexcept {
+    return players_generation_;
+}
+
 bool Application::IsTokenValid(std::string_view token) const {
-    return tokens_.FindPlayerByToken(user::Token{std::string(token)});
+    return tokens_.FindPlayerByToken(token) != nullptr;
+}
+
+user::Player* Application::FindPlayer(std::string_view token) {
+    return tokens_.FindPlayerByToken(token);
+}
+
+const user::Player* Application::FindPlayer(std::string_view token) const {
+    return tokens_.FindPlayerByToken(token);
 }
 
 void Application::SetListener(ApplicationListener* listener) {
@@ -182,10 +231,41 @@ void Application::SetListener(ApplicationListener* listener) {
     }
 }
 
-void Application::NotifyListenersTick(std::int64_t tick) const {
+void Application::SetTickBudget(std::chrono::milliseconds budget) {
+    tick_budget_ = std::max(budget, std::chrono::milliseconds{0});
+}
+
+std::chrono::milliseconds Application::GetTickBudget() const noexcept {
+    return tick_budget_;
+}
+
+const TickPhases& Application::GetLastTickPhases() const noexcept {
+    return last_tick_phases_;
+}
+
+bool Application::IsLastTickOverBudget() const noexcept {
+    return tick_budget_.count() > 0 && last_tick_phases_.total > tick_budget_;
+}
+
+void Application::NotifyListenersTick(std::int64_t tick) {
+    last_tick_phases_.listeners.clear();
     for (auto* listener : listeners_) {
         if (listener != nullptr) {
+            const auto start = std::chrono::steady_clock::now();
             listener->OnTick(std::chrono::milliseconds{tick});
+            last_tick_phases_.listeners.push_back({listener->GetName(), std::chrono::steady_clock::now() - start});
+        }
+    }
+}
+
+void Application::NotifyListenersTickProcessed(std::int64_t tick) {
+    last_tick_phases_.processed_listeners.clear();
+    for (auto* listener : listeners_) {
+        if (listener != nullptr) {
+            const auto start = std::chrono::steady_clock::now();
+            listener->OnTickProcessed(std::chrono::milliseconds{tick});
+            last_tick_phases_.processed_listeners.push_back({listener->GetName(),
+                                                             std::chrono::steady_clock::now() - start});
         }
     }
 }
@@ -198,4 +278,12 @@ void Application::NotifyListenersJoin(std::string token, model::Dog* dog) const
     }
 }
 
+void Application::NotifyListenersMove(model::Dog* dog, std::string_view move) const {
+    for (auto* listener : listeners_) {
+        if (listener != nullptr) {
+            listener->OnMove(dog, move);
+        }
+    }
+}
+
 } // namespace app
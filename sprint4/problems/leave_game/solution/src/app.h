@@ -6,7 +6,10 @@
 #include "model.h"
 #include "./leaderboard/leaderboard.h"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -125,6 +128,9 @@ private:
 //**************************************************************
 //ManageDogActionsUseCase
 
+// "" - остановиться, "L", "R", "U", "D" - направление; nullopt - неизвестная команда
+std::optional<model::DogCommand> ParseDogCommand(model::Dog::Id dog_id, std::string_view move);
+
 class ManageDogActionsUseCase {
 public:
     ManageDogActionsUseCase(user::Players* players, user::PlayerTokens* tokens)
@@ -133,6 +139,7 @@ public:
     }
 
     bool MoveDog(std::string_view token, std::string_view move);
+    bool MoveDog(user::Player& player, std::string_view move);
 
 private:
     user::Players* players_;
@@ -148,7 +155,7 @@ public:
         : game_(game) {
     }
 
-    void ProcessTick(std::int64_t tick);
+    model::TickReport ProcessTick(std::int64_t tick);
 
 private:
     model::Game* game_;
@@ -195,12 +202,38 @@ private:
 class ApplicationListener {
 public:
     virtual void OnTick(std::chrono::milliseconds delta) = 0;
+    // вызывается после обновления игры, когда состояние уже соответствует концу тика
+    virtual void OnTickProcessed(std::chrono::milliseconds delta) {}
     virtual void OnJoin(std::string token, model::Dog* dog) {}
+    // вызывается после того, как команда игрока применена
+    virtual void OnMove(model::Dog* dog, std::string_view move) {}
+    // имя фазы в отчете о медленном тике
+    virtual std::string_view GetName() const {
+        return "listener";
+    }
 
 protected:
     ~ApplicationListener() = default;
 };
 
+//**************************************************************
+//TickPhases
+
+struct ListenerTickTime {
+    std::string_view name;
+    std::chrono::nanoseconds duration;
+};
+
+// разбивка последнего тика по фазам: слушатели, обновление игры, слушатели после тика
+struct TickPhases {
+    std::vector<ListenerTickTime> listeners;
+    std::chrono::nanoseconds update_state{0};
+    std::vector<ListenerTickTime> processed_listeners;
+    std::chrono::nanoseconds total{0};
+    // заполняется только для тиков, превысивших бюджет
+    std::vector<model::SessionTickTime> sessions;
+};
+
 //**************************************************************
 //Application
 
@@ -224,23 +257,49 @@ public:
     const model::GameSession::IdToDogIndex& ListPlayers(std::string_view token) const;
     JoinGameResult JoinGame(const std::string& user_name, const std::string& map_id);
     bool MoveDog(std::string_view token, std::string_view move);
-    void ProcessTick(std::int64_t tick);
+    // для игрока, уже найденного по токену: без повторного поиска
+    bool MoveDog(user::Player& player, std::string_view move);
+    // сначала применяются команды, накопленные в очередях сессий, затем моделируется время
+    model::TickReport ProcessTick(std::int64_t tick);
     void DeletePlayer(const std::string& player_token);
     void SaveToLeaderboard(const std::string& name, std::uint16_t score, std::uint16_t time_in_game_ms);
     std::vector<domain::RetiredPlayer> GetLeaders(size_t start, size_t max_players);
 
     bool IsTokenValid(std::string_view token) const;
+    // растет при каждом входе и удалении игрока: по нему видно, менялся ли состав игроков
+    std::uint64_t GetPlayersGeneration() const noexcept;
+    // токен ищется один раз на запрос, дальше обработчик работает с найденным игроком; nullptr, если игрока нет
+    user::Player* FindPlayer(std::string_view token);
+    const user::Player* FindPlayer(std::string_view token) const;
     void SetListener(ApplicationListener* listener);
 
+    // fn(std::string_view token, const model::GameSession* session, model::Dog::Id dog_id) для каждого игрока
+    template <typename Fn>
+    void ForEachPlayerSession(Fn&& fn) const {
+        tokens_.ForEachPlayer([&fn](std::string_view token, const user::Player* player) {
+            fn(token, player->GetGameSession(), player->GetDog()->GetId());
+        });
+    }
+
+    // 0 - бюджет не задан, тик никогда не считается медленным
+    void SetTickBudget(std::chrono::milliseconds budget);
+    std::chrono::milliseconds GetTickBudget() const noexcept;
+    const TickPhases& GetLastTickPhases() const noexcept;
+    bool IsLastTickOverBudget() const noexcept;
+
 private:
     model::Game* game_;
     user::Players players_;
     user::PlayerTokens tokens_;
+    std::uint64_t players_generation_ = 0;
 
     std::shared_ptr<leaderboard::Leaderboard> leaderboard_ = nullptr;
 
     std::vector<ApplicationListener*> listeners_;
 
+    std::chrono::milliseconds tick_budget_{0};
+    TickPhases last_tick_phases_;
+
     // create all scenario below
     GetMapUseCase get_map_use_case_{game_};
     ListMapsUseCase list_maps_use_case_{game_};
@@ -251,7 +310,8 @@ private:
     DeletePlayerUseCase delete_player_use_case_{game_, &players_, &tokens_};
     LeaderboardUseCase leaderboard_use_case_{leaderboard_.get()};
 
-    void NotifyListenersTick(std::int64_t tick) const;
+    void NotifyListenersTick(std::int64_t tick);
+    void NotifyListenersTickProcessed(std::int64_t tick);
     void NotifyListenersJoin(std::string token, model::Dog* dog) const;
     void NotifyListenersMove(model::Dog* dog, std::string_view move) const;
 };
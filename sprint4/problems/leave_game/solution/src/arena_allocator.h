@@ -0,0 +1,68 @@
+#pragma once
+
+#include <boost/beast/http/fields.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+
+namespace http_server {
+
+namespace http = boost::beast::http;
+
+/* Распределитель из пула соединения. Пул разделяется через shared_ptr: запрос или ответ
+   может пережить сессию (например, в обработчике на другом strand), и память вернется в пул,
+   который еще жив. Освобожденные блоки достаются следующим сообщениям того же соединения
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    // без пула память берется из кучи, как у std::allocator
+    ArenaAllocator() noexcept
+        : arena_(std::shared_ptr<void>{}, std::pmr::new_delete_resource()) {
+    }
+
+    explicit ArenaAllocator(std::shared_ptr<std::pmr::memory_resource> arena) noexcept
+        : arena_(std::move(arena)) {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+        : arena_(other.GetArena()) {
+    }
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept {
+        arena_->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    const std::shared_ptr<std::pmr::memory_resource>& GetArena() const noexcept {
+        return arena_;
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept {
+        return arena_.get() == other.GetArena().get();
+    }
+
+private:
+    std::shared_ptr<std::pmr::memory_resource> arena_;
+};
+
+// пул одного соединения: запросы и ответы обрабатываются в разных потоках, поэтому он синхронизирован
+inline std::shared_ptr<std::pmr::memory_resource> MakeConnectionArena() {
+    return std::make_shared<std::pmr::synchronized_pool_resource>();
+}
+
+using ArenaFields = http::basic_fields<ArenaAllocator<char>>;
+using StringRequest = http::request<http::string_body, ArenaFields>;
+
+}  // namespace http_server
@@ -0,0 +1,250 @@
+#include "async_log.h"
+
+#include <boost/date_time/c_local_time_adjustor.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/json.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace http_logger {
+
+namespace json = boost::json;
+
+namespace {
+
+std::atomic<std::uint64_t> next_log_id{1};
+
+// кольцо текущего потока запоминается для последнего журнала, в который поток писал
+struct ThreadState {
+    std::uint64_t log_id = 0;
+    void* ring = nullptr;
+    std::size_t sample_counter = 0;
+};
+
+thread_local ThreadState thread_state;
+
+template <std::size_t N>
+std::uint8_t CopyTruncated(std::array<char, N>& dest, std::string_view src) noexcept {
+    static_assert(N <= 255);
+    const std::size_t size = std::min(N, src.size());
+    std::memcpy(dest.data(), src.data(), size);
+    return static_cast<std::uint8_t>(size);
+}
+
+std::int64_t NowMicroseconds() noexcept {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+// время в том же виде, что у атрибута TimeStamp Boost.Log: местное, с микросекундами
+std::string FormatTimestamp(std::int64_t timestamp) {
+    using namespace boost::posix_time;
+    const ptime utc = from_time_t(0) + microseconds(timestamp);
+    return to_iso_extended_string(boost::date_time::c_local_adjustor<ptime>::utc_to_local(utc));
+}
+
+json::object MakeData(const AccessRecord& record, json::storage_ptr storage) {
+    json::object data(storage);
+    if (record.kind == AccessRecord::Kind::request) {
+        json::string uri(json::string_view{record.uri.data(), record.uri_size}, storage);
+        if (record.uri_truncated) {
+            uri.append("...");
+        }
+        const auto method = http::to_string(record.method);
+        data["ip"] = json::string_view{record.ip.data(), record.ip_size};
+        data["URI"] = std::move(uri);
+        data["method"] = json::string_view{method.data(), method.size()};
+    } else {
+        data["response_time"] = record.response_time;
+        data["code"] = static_cast<unsigned>(record.code);
+        data["content_type"] = json::string_view{record.content_type.data(), record.content_type_size};
+    }
+    return data;
+}
+
+void AppendLine(std::int64_t timestamp, json::object data, std::string_view message,
+                json::serializer& serializer, std::string& batch) {
+    const std::string formatted_timestamp = FormatTimestamp(timestamp);
+    json::object line(data.storage());
+    line["timestamp"] = json::string_view{formatted_timestamp.data(), formatted_timestamp.size()};
+    line["data"] = std::move(data);
+    line["message"] = json::string_view{message.data(), message.size()};
+
+    char buffer[512];
+    serializer.reset(&line);
+    while (!serializer.done()) {
+        const auto chunk = serializer.read(buffer);
+        batch.append(chunk.data(), chunk.size());
+    }
+    batch += '\n';
+}
+
+} // namespace
+
+AsyncLog::ThreadRing::ThreadRing(std::thread::id id, std::size_t capacity)
+    : thread_id(id)
+    , ring(capacity) {
+}
+
+AsyncLog::AsyncLog(std::ostream& output, AsyncLogConfig config)
+    : id_(next_log_id.fetch_add(1, std::memory_order_relaxed))
+    , output_(output)
+    , config_(config) {
+    config_.sample_rate = std::max<std::size_t>(config_.sample_rate, 1);
+    writer_ = std::thread{[this] {
+        Run();
+    }};
+}
+
+AsyncLog::~AsyncLog() {
+    Stop();
+}
+
+bool AsyncLog::Sample() noexcept {
+    return config_.sample_rate == 1 || ++thread_state.sample_counter % config_.sample_rate == 0;
+}
+
+void AsyncLog::LogRequest(std::string_view client_ip, std::string_view uri, http::verb method) noexcept {
+    Push([&](AccessRecord& record) {
+        record.timestamp = NowMicroseconds();
+        record.kind = AccessRecord::Kind::request;
+        record.method = method;
+        record.ip_size = CopyTruncated(record.ip, client_ip);
+        record.uri_size = CopyTruncated(record.uri, uri);
+        record.uri_truncated = uri.size() > record.uri_size;
+    });
+}
+
+void AsyncLog::LogResponse(std::uint64_t response_time, unsigned code, std::string_view content_type) noexcept {
+    Push([&](AccessRecord& record) {
+        record.timestamp = NowMicroseconds();
+        record.kind = AccessRecord::Kind::response;
+        record.response_time = response_time;
+        record.code = static_cast<std::uint16_t>(code);
+        record.content_type_size = CopyTruncated(record.content_type, content_type);
+    });
+}
+
+void AsyncLog::Stop() {
+    {
+        std::lock_guard lock{stop_mutex_};
+        stopping_ = true;
+    }
+    stop_cv_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+std::uint64_t AsyncLog::GetDropped() const noexcept {
+    std::lock_guard lock{rings_mutex_};
+    std::uint64_t dropped = 0;
+    for (const auto& ring : rings_) {
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+template <typename Fill>
+void AsyncLog::Push(Fill&& fill) noexcept {
+    try {
+        ThreadRing& ring = GetThreadRing();
+        if (!ring.ring.TryPush(fill)) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    } catch (...) {
+        // кольцо для нового потока не выделилось: запись теряется, запрос обслуживается дальше
+    }
+}
+
+AsyncLog::ThreadRing& AsyncLog::GetThreadRing() {
+    if (thread_state.log_id != id_) {
+        thread_state.ring = &RegisterThread();
+        thread_state.log_id = id_;
+    }
+    return *static_cast<ThreadRing*>(thread_state.ring);
+}
+
+AsyncLog::ThreadRing& AsyncLog::RegisterThread() {
+    const auto thread_id = std::this_thread::get_id();
+    std::lock_guard lock{rings_mutex_};
+    // поток мог уже писать сюда, а потом переключиться на другой журнал
+    for (const auto& ring : rings_) {
+        if (ring->thread_id == thread_id) {
+            return *ring;
+        }
+    }
+    return *rings_.emplace_back(std::make_unique<ThreadRing>(thread_id, config_.ring_capacity));
+}
+
+void AsyncLog::Run() {
+    std::vector<ThreadRing*> rings;
+    std::string batch;
+    std::unique_lock lock{stop_mutex_};
+    for (bool stopping = false; !stopping;) {
+        stopping = stop_cv_.wait_for(lock, config_.flush_period, [this] {
+            return stopping_;
+        });
+        lock.unlock();
+        Flush(rings, batch);
+        lock.lock();
+    }
+}
+
+void AsyncLog::Flush(std::vector<ThreadRing*>& rings, std::string& batch) {
+    {
+        std::lock_guard lock{rings_mutex_};
+        rings.clear();
+        for (const auto& ring : rings_) {
+            rings.push_back(ring.get());
+        }
+    }
+
+    // запрос и его ответ могут прийти из разных потоков, поэтому пачка упорядочивается по времени
+    std::uint64_t dropped = 0;
+    pending_.clear();
+    for (ThreadRing* ring : rings) {
+        ring->ring.PopAll([this](const AccessRecord& record) {
+            pending_.push_back(record);
+        });
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    std::stable_sort(pending_.begin(), pending_.end(), [](const AccessRecord& lhs, const AccessRecord& rhs) {
+        return lhs.timestamp < rhs.timestamp;
+    });
+
+    json::serializer serializer;
+    unsigned char buffer[RECORD_BUFFER_SIZE];
+    for (const AccessRecord& record : pending_) {
+        json::monotonic_resource resource{buffer, sizeof(buffer)};
+        AppendLine(record.timestamp, MakeData(record, &resource),
+                   record.kind == AccessRecord::Kind::request ? "request received" : "response sent",
+                   serializer, batch);
+        if (batch.size() >= MAX_BATCH_SIZE) {
+            WriteBatch(batch);
+        }
+    }
+
+    if (dropped != reported_dropped_) {
+        json::monotonic_resource resource{buffer, sizeof(buffer)};
+        json::object data(&resource);
+        data["dropped"] = dropped - reported_dropped_;
+        data["total_dropped"] = dropped;
+        AppendLine(NowMicroseconds(), std::move(data), "access log records dropped", serializer, batch);
+        reported_dropped_ = dropped;
+    }
+    WriteBatch(batch);
+}
+
+void AsyncLog::WriteBatch(std::string& batch) {
+    if (batch.empty()) {
+        return;
+    }
+    // одна запись на пачку: строки Boost.Log из других потоков не разрывают строки журнала
+    output_.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+    output_.flush();
+    batch.clear();
+}
+
+} // namespace http_logger
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <boost/beast/http/verb.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+
+namespace http_logger {
+
+namespace http = boost::beast::http;
+
+// запись журнала запросов в том виде, в каком ее кладет поток ввода-вывода: числа и строки фиксированной длины
+struct AccessRecord {
+    constexpr static std::size_t IP_CAPACITY = 46;
+    constexpr static std::size_t CONTENT_TYPE_CAPACITY = 64;
+    constexpr static std::size_t URI_CAPACITY = 192;
+
+    enum class Kind : std::uint8_t {
+        request, response
+    };
+
+    // микросекунды от начала эпохи system_clock
+    std::int64_t timestamp = 0;
+    std::uint64_t response_time = 0;
+    Kind kind = Kind::request;
+    http::verb method = http::verb::unknown;
+    std::uint16_t code = 0;
+    std::uint8_t ip_size = 0;
+    std::uint8_t content_type_size = 0;
+    std::uint8_t uri_size = 0;
+    bool uri_truncated = false;
+    std::array<char, IP_CAPACITY> ip;
+    std::array<char, CONTENT_TYPE_CAPACITY> content_type;
+    std::array<char, URI_CAPACITY> uri;
+};
+
+struct AsyncLogConfig {
+    // пишется каждый sample_rate-й запрос каждого потока вместе со своим ответом
+    std::size_t sample_rate = 1;
+    // записей в кольце одного потока; если поток записи не успевает, лишние записи отбрасываются и считаются
+    std::size_t ring_capacity = 4096;
+    std::chrono::milliseconds flush_period{10};
+};
+
+/* Журнал запросов и ответов без форматирования на горячем пути. Каждый поток пишет записи
+   в свое кольцо, фоновый поток раз в flush_period собирает их, форматирует в те же JSON-строки,
+   что и Boost.Log, и выводит пачкой одной операцией записи
+ */
+class AsyncLog {
+public:
+    explicit AsyncLog(std::ostream& output, AsyncLogConfig config = {});
+    ~AsyncLog();
+
+    AsyncLog(const AsyncLog&) = delete;
+    AsyncLog& operator=(const AsyncLog&) = delete;
+
+    // true - этот запрос попал в выборку и его надо записать
+    bool Sample() noexcept;
+
+    void LogRequest(std::string_view client_ip, std::string_view uri, http::verb method) noexcept;
+    void LogResponse(std::uint64_t response_time, unsigned code, std::string_view content_type) noexcept;
+
+    // дописывает все накопленное и останавливает фоновый поток; записи после Stop теряются
+    void Stop();
+
+    std::uint64_t GetDropped() const noexcept;
+
+private:
+    using Ring = util::SpscRing<AccessRecord>;
+
+    struct ThreadRing {
+        std::thread::id thread_id;
+        Ring ring;
+        std::atomic<std::uint64_t> dropped{0};
+
+        ThreadRing(std::thread::id id, std::size_t capacity);
+    };
+
+    constexpr static std::size_t MAX_BATCH_SIZE = 64 * 1024;
+    // памяти под одну строку хватает с запасом, форматирование обходится без кучи
+    constexpr static std::size_t RECORD_BUFFER_SIZE = 4 * 1024;
+
+    const std::uint64_t id_;
+    std::ostream& output_;
+    AsyncLogConfig config_;
+
+    // кольца регистрируются один раз на поток, читаются только фоновым потоком
+    mutable std::mutex rings_mutex_;
+    std::vector<std::unique_ptr<ThreadRing>> rings_;
+
+    std::mutex stop_mutex_;
+    std::condition_variable stop_cv_;
+    bool stopping_ = false;
+    // дальше - только для фонового потока
+    std::vector<AccessRecord> pending_;
+    std::uint64_t reported_dropped_ = 0;
+    std::thread writer_;
+
+    template <typename Fill>
+    void Push(Fill&& fill) noexcept;
+    ThreadRing& GetThreadRing();
+    ThreadRing& RegisterThread();
+
+    void Run();
+    // выводит все, что успели записать потоки
+    void Flush(std::vector<ThreadRing*>& rings, std::string& batch);
+    void WriteBatch(std::string& batch);
+};
+
+} // namespace http_logger
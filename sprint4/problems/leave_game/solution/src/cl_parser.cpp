@@ -20,7 +20,22 @@ namespace po = boost::program_options;
         ("www-root,w", po::value(&args.static_root)->value_name("dir"s), "set static files root")
         ("randomize-spawn-points", po::bool_switch(&args.random_spawn_point), "spawn dogs at random positions")
         ("state-file", po::value(&args.state_file)->value_name("file"s), "set save state file")
-        ("save-state-period", po::value<std::int64_t>(&args.save_state_period)->value_name("milliseconds"s), "set save state period");
+        ("save-state-period", po::value<std::int64_t>(&args.save_state_period)->value_name("milliseconds"s), "set save state period")
+        ("save-state-in-background", po::bool_switch(&args.background_save), "write periodic saves on a background thread")
+        ("tick-workers", po::value<unsigned>(&args.tick_workers)->value_name("threads"s), "update game sessions in parallel on a worker pool")
+        ("random-seed", po::value<std::uint64_t>()->value_name("seed"s), "seed random generators of game sessions for reproducible runs")
+        ("max-tick-step", po::value<std::int64_t>(&args.max_tick_step)->value_name("milliseconds"s), "split large time deltas into steps of at most this length")
+        ("max-tick-catch-up", po::value<std::int64_t>(&args.max_tick_catch_up)->value_name("milliseconds"s), "simulate at most this much time per tick, drop the rest")
+        ("tick-budget", po::value<std::int64_t>(&args.tick_budget)->value_name("milliseconds"s), "log a per-phase breakdown of ticks that take longer than this")
+        ("max-pipelined-requests", po::value<std::size_t>(&args.max_pipelined_requests)->value_name("requests"s), "read ahead at most this many pipelined requests per connection")
+        ("request-header-limit", po::value<std::uint32_t>(&args.request_header_limit)->value_name("bytes"s), "reject requests with larger headers")
+        ("request-body-limit", po::value<std::uint64_t>(&args.request_body_limit)->value_name("bytes"s), "reject requests with larger bodies")
+        ("max-connections", po::value<std::size_t>(&args.max_connections)->value_name("connections"s), "answer 503 to new connections above this number")
+        ("max-connections-per-ip", po::value<std::size_t>(&args.max_connections_per_ip)->value_name("connections"s), "answer 503 to new connections from an address above this number")
+        ("max-api-queue", po::value<std::size_t>(&args.max_api_queue)->value_name("requests"s), "answer 503 to new connections while more requests wait for the game strand")
+        ("max-tick-lag", po::value<std::int64_t>(&args.max_tick_lag)->value_name("milliseconds"s), "answer 503 to new connections while ticks are late by more than this")
+        ("io-per-core", po::bool_switch(&args.io_per_core), "serve connections on an io_context per core with SO_REUSEPORT acceptors")
+        ("log-sample-rate", po::value<std::size_t>(&args.log_sample_rate)->value_name("requests"s), "log one of every this many requests with its response");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -39,14 +54,49 @@ namespace po = boost::program_options;
             << "             --www-root <static-files-dir>\n"s
             << "             --randomize-spawn-points (optional)\n"s
             << "             --state-file <state-file-path> (optional)\n"s
-            << "             --save-state-period <tick-period in ms> (optional)\n"s;
+            << "             --save-state-period <tick-period in ms> (optional)\n"s
+            << "             --save-state-in-background (optional)\n"s
+            << "             --tick-workers <threads> (optional)\n"s
+            << "             --random-seed <seed> (optional)\n"s
+            << "             --max-tick-step <step in ms> (optional)\n"s
+            << "             --max-tick-catch-up <time in ms> (optional)\n"s
+            << "             --tick-budget <time in ms> (optional)\n"s
+            << "             --max-pipelined-requests <requests> (optional)\n"s
+            << "             --request-header-limit <bytes> (optional)\n"s
+            << "             --request-body-limit <bytes> (optional)\n"s
+            << "             --max-connections <connections> (optional)\n"s
+            << "             --max-connections-per-ip <connections> (optional)\n"s
+            << "             --max-api-queue <requests> (optional)\n"s
+            << "             --max-tick-lag <time in ms> (optional)\n"s
+            << "             --log-sample-rate <requests> (optional)\n"s
+            << "             --io-per-core (optional)\n"s;
         throw std::runtime_error(ss.str());
     }
 
+    if (vm.contains("random-seed")) {
+        args.random_seed = vm["random-seed"].as<std::uint64_t>();
+    }
+
     if (vm.contains("tick-period") && args.tick_period < 0) {
         throw std::runtime_error("Tick-period must be positive number in ms"s);
     }
 
+    if (args.max_tick_step < 0 || args.max_tick_catch_up < 0) {
+        throw std::runtime_error("Max tick step and catch-up must be positive numbers in ms"s);
+    }
+
+    if (args.tick_budget < 0) {
+        throw std::runtime_error("Tick budget must be positive number in ms"s);
+    }
+
+    if (args.max_tick_lag < 0) {
+        throw std::runtime_error("Max tick lag must be positive number in ms"s);
+    }
+
+    if (args.log_sample_rate == 0) {
+        throw std::runtime_error("Log sample rate must be positive number of requests"s);
+    }
+
     return args;
 }
 
@@ -12,10 +12,25 @@ namespace cl_parser {
 struct Args {
     std::int64_t tick_period = 0;
     std::int64_t save_state_period = 0;
+    unsigned tick_workers = 0;
+    std::int64_t max_tick_step = 0;
+    std::int64_t max_tick_catch_up = 0;
+    std::int64_t tick_budget = 0;
+    std::size_t max_pipelined_requests = 0;
+    std::uint32_t request_header_limit = 0;
+    std::uint64_t request_body_limit = 0;
+    std::size_t max_connections = 0;
+    std::size_t max_connections_per_ip = 0;
+    std::size_t max_api_queue = 0;
+    std::int64_t max_tick_lag = 0;
+    std::size_t log_sample_rate = 1;
+    std::optional<std::uint64_t> random_seed;
     std::string config_file_path;
     std::string static_root;
     std::string state_file;
     bool random_spawn_point = false;
+    bool io_per_core = false;
+    bool background_save = false;
 };
 
 [[nodiscard]] std::optional<Args> ParseComandLine(int argc, const char* const argv[]);
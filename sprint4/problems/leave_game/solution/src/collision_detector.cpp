@@ -1,8 +1,43 @@
 #include "collision_detector.h"
 #include <cassert>
+#include <cmath>
 
 namespace collision_detector {
 
+namespace {
+
+// запас к радиусу сбора, чтобы ошибки округления в TryCollectPoint
+// не давали событий для предметов чуть за границей сетки
+constexpr double BROAD_PHASE_MARGIN = 1e-3;
+constexpr double MIN_CELL_SIZE = 1.;
+
+struct ItemCell {
+    std::uint64_t key;
+    size_t item_id;
+};
+
+std::int64_t GetCell(double coord, double cell_size) {
+    return static_cast<std::int64_t>(std::floor(coord / cell_size));
+}
+
+std::uint64_t GetCellKey(std::int64_t cell_x, std::int64_t cell_y) {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(cell_x)) << 32)
+        | static_cast<std::uint32_t>(cell_y);
+}
+
+bool IsSamePoint(geom::Point2D p1, geom::Point2D p2) {
+    return p1.x == p2.x && p1.y == p2.y;
+}
+
+void SortByTime(std::vector<GatheringEvent>& events) {
+    std::sort(events.begin(), events.end(),
+              [](const GatheringEvent& e_l, const GatheringEvent& e_r) {
+                  return e_l.time < e_r.time;
+              });
+}
+
+} // namespace
+
 CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D c) {
     const double u_x = c.x - a.x;
     const double u_y = c.y - a.y;
@@ -17,17 +52,108 @@ CollectionResult TryCollectPoint(geom::Point2D a, geom::Point2D b, geom::Point2D
     return CollectionResult(sq_distance, proj_ratio);
 }
 
-std::vector<GatheringEvent> FindGatherEvents(
-    const ItemGathererProvider& provider) {
+std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider) {
     std::vector<GatheringEvent> detected_events;
 
-    static auto eq_pt = [](geom::Point2D p1, geom::Point2D p2) {
-        return p1.x == p2.x && p1.y == p2.y;
-    };
+    const size_t items_count = provider.ItemsCount();
+    const size_t gatherers_count = provider.GatherersCount();
+    if (items_count == 0 || gatherers_count == 0) {
+        return detected_events;
+    }
+
+    std::vector<Item> items;
+    items.reserve(items_count);
+    double max_item_width = 0.;
+    for (size_t i = 0; i < items_count; ++i) {
+        items.push_back(provider.GetItem(i));
+        max_item_width = std::max(max_item_width, items.back().width);
+    }
+
+    std::vector<Gatherer> gatherers;
+    gatherers.reserve(gatherers_count);
+    double max_gatherer_width = 0.;
+    for (size_t g = 0; g < gatherers_count; ++g) {
+        gatherers.push_back(provider.GetGatherer(g));
+        max_gatherer_width = std::max(max_gatherer_width, gatherers.back().width);
+    }
+
+    const double reach = max_gatherer_width + max_item_width + BROAD_PHASE_MARGIN;
+    const double cell_size = std::max(2. * reach, MIN_CELL_SIZE);
+
+    // ячейки отсортированы по ключу, внутри ячейки - по номеру предмета
+    std::vector<ItemCell> cells;
+    cells.reserve(items_count);
+    for (size_t i = 0; i < items_count; ++i) {
+        cells.push_back({GetCellKey(GetCell(items[i].position.x, cell_size),
+                                    GetCell(items[i].position.y, cell_size)), i});
+    }
+    std::sort(cells.begin(), cells.end(), [](const ItemCell& lhs, const ItemCell& rhs) {
+        return lhs.key < rhs.key || (lhs.key == rhs.key && lhs.item_id < rhs.item_id);
+    });
+
+    std::vector<size_t> candidates;
+    for (size_t g = 0; g < gatherers_count; ++g) {
+        const Gatherer& gatherer = gatherers[g];
+        if (IsSamePoint(gatherer.start_pos, gatherer.end_pos)) {
+            continue;
+        }
+
+        const std::int64_t min_cell_x = GetCell(std::min(gatherer.start_pos.x, gatherer.end_pos.x) - reach, cell_size);
+        const std::int64_t max_cell_x = GetCell(std::max(gatherer.start_pos.x, gatherer.end_pos.x) + reach, cell_size);
+        const std::int64_t min_cell_y = GetCell(std::min(gatherer.start_pos.y, gatherer.end_pos.y) - reach, cell_size);
+        const std::int64_t max_cell_y = GetCell(std::max(gatherer.start_pos.y, gatherer.end_pos.y) + reach, cell_size);
+
+        candidates.clear();
+        const double cells_to_visit = static_cast<double>(max_cell_x - min_cell_x + 1)
+                                    * static_cast<double>(max_cell_y - min_cell_y + 1);
+        if (cells_to_visit >= static_cast<double>(items_count)) {
+            // длинный отрезок задевает больше ячеек, чем есть предметов: дешевле проверить все
+            for (size_t i = 0; i < items_count; ++i) {
+                candidates.push_back(i);
+            }
+        } else {
+            for (std::int64_t cell_x = min_cell_x; cell_x <= max_cell_x; ++cell_x) {
+                for (std::int64_t cell_y = min_cell_y; cell_y <= max_cell_y; ++cell_y) {
+                    const std::uint64_t key = GetCellKey(cell_x, cell_y);
+                    auto first = std::lower_bound(cells.begin(), cells.end(), key,
+                                                  [](const ItemCell& cell, std::uint64_t key) {
+                        return cell.key < key;
+                    });
+                    for (; first != cells.end() && first->key == key; ++first) {
+                        candidates.push_back(first->item_id);
+                    }
+                }
+            }
+            // тот же порядок проверки, что и в полном переборе
+            std::sort(candidates.begin(), candidates.end());
+        }
+
+        for (size_t i : candidates) {
+            const Item& item = items[i];
+            auto collect_result
+                = TryCollectPoint(gatherer.start_pos, gatherer.end_pos, item.position);
+
+            if (collect_result.IsCollected(gatherer.width + item.width)) {
+                GatheringEvent evt{.item_id = i,
+                                   .gatherer_id = g,
+                                   .sq_distance = collect_result.sq_distance,
+                                   .time = collect_result.proj_ratio};
+                detected_events.push_back(evt);
+            }
+        }
+    }
+
+    SortByTime(detected_events);
+    return detected_events;
+}
+
+std::vector<GatheringEvent> FindGatherEventsBruteForce(
+    const ItemGathererProvider& provider) {
+    std::vector<GatheringEvent> detected_events;
 
     for (size_t g = 0; g < provider.GatherersCount(); ++g) {
         Gatherer gatherer = provider.GetGatherer(g);
-        if (eq_pt(gatherer.start_pos, gatherer.end_pos)) {
+        if (IsSamePoint(gatherer.start_pos, gatherer.end_pos)) {
             continue;
         }
         for (size_t i = 0; i < provider.ItemsCount(); ++i) {
@@ -45,11 +171,7 @@ std::vector<GatheringEvent> FindGatherEvents(
         }
     }
 
-    std::sort(detected_events.begin(), detected_events.end(),
-              [](const GatheringEvent& e_l, const GatheringEvent& e_r) {
-                  return e_l.time < e_r.time;
-              });
-
+    SortByTime(detected_events);
     return detected_events;
 }
 }  // namespace collision_detector
@@ -3,6 +3,7 @@
 #include "geom.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <vector>
 
 namespace collision_detector {
@@ -50,6 +51,11 @@ struct GatheringEvent {
     double time;
 };
 
+// предметы раскладываются по равномерной сетке, и каждый собиратель проверяет только
+// предметы из ячеек, которые задевает его отрезок. Порядок событий тот же, что у полного перебора
 std::vector<GatheringEvent> FindGatherEvents(const ItemGathererProvider& provider);
 
+// полный перебор всех пар собиратель-предмет, эталон для тестов и бенчмарков
+std::vector<GatheringEvent> FindGatherEventsBruteForce(const ItemGathererProvider& provider);
+
 }  // namespace collision_detector
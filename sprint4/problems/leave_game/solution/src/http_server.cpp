@@ -3,6 +3,10 @@
 
 #include <boost/asio/dispatch.hpp>
 
+#include <sys/sendfile.h>
+
+#include <array>
+#include <cerrno>
 #include <iostream>
 
 namespace http_server {
@@ -14,6 +18,66 @@ void ReportError(beast::error_code ec, std::string_view what) {
     std::cerr << what << ": "sv << ec.message() << std::endl;
 }
 
+namespace {
+
+// ответ собран заранее: отказ не должен стоить ни разбора запроса, ни выделений под заголовки
+constexpr std::string_view OVERLOAD_RESPONSE =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Content-Type: application/json\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Retry-After: 1\r\n"
+    "Connection: close\r\n"
+    "Content-Length: 62\r\n"
+    "\r\n"
+    R"({"code":"serviceUnavailable","message":"Server is overloaded"})";
+
+/* Отклоненное соединение. После ответа входящие данные дочитываются и отбрасываются:
+   если закрыть сокет с непрочитанным запросом, ядро пошлет RST и клиент может не увидеть 503
+ */
+class RejectedConnection : public std::enable_shared_from_this<RejectedConnection> {
+public:
+    constexpr static std::chrono::seconds TIMEOUT{1};
+    constexpr static std::size_t MAX_DRAIN_BYTES = 64 * 1024;
+
+    explicit RejectedConnection(tcp::socket&& socket)
+        : stream_(std::move(socket)) {
+    }
+
+    void Run() {
+        stream_.expires_after(TIMEOUT);
+        net::async_write(stream_, net::buffer(OVERLOAD_RESPONSE),
+                         [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) {
+                return;
+            }
+            self->stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+            self->Drain();
+        });
+    }
+
+private:
+    beast::tcp_stream stream_;
+    std::array<char, 1024> drain_buffer_;
+    std::size_t drained_ = 0;
+
+    void Drain() {
+        stream_.async_read_some(net::buffer(drain_buffer_),
+                                [self = shared_from_this()](beast::error_code ec, std::size_t bytes_read) {
+            self->drained_ += bytes_read;
+            // конец потока, таймаут или клиент, который шлет слишком много, - соединение закрывается
+            if (!ec && self->drained_ < MAX_DRAIN_BYTES) {
+                self->Drain();
+            }
+        });
+    }
+};
+
+}  // namespace
+
+void RejectConnection(tcp::socket&& socket) {
+    std::make_shared<RejectedConnection>(std::move(socket))->Run();
+}
+
 void SessionBase::Run() {
     net::dispatch(
         stream_.get_executor(),
@@ -21,40 +85,172 @@ void SessionBase::Run() {
 }
 
 void SessionBase::Read() {
-    request_ = {};
-    stream_.expires_after(30s);
-    http::async_read(stream_, buffer_, request_,
+    // следующий запрос читается сразу, пока неотправленных ответов не слишком много
+    const std::size_t in_flight = responses_.size() + (writing_ ? 1 : 0);
+    if (reading_ || read_closed_ || in_flight >= limits_.max_in_flight) {
+        return;
+    }
+
+    reading_ = true;
+    parser_.emplace(std::piecewise_construct, std::make_tuple(), std::make_tuple(ArenaAllocator<char>{arena_}));
+    parser_->header_limit(limits_.header_limit);
+    parser_->body_limit(limits_.body_limit);
+    stream_.expires_after(IO_TIMEOUT);
+    http::async_read(stream_, buffer_, *parser_,
                      beast::bind_front_handler(&SessionBase::OnRead, GetSharedThis()));
-    
 }
 
 void SessionBase::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
-    if (ec == http::error::end_of_stream) {
-        return Close();
-    }
+    reading_ = false;
 
     if (ec) {
-        return ReportError(ec, "read"sv);
+        read_closed_ = true;
+        // operation_aborted - чтение отменено при закрытии соединения
+        if (ec != http::error::end_of_stream && ec != net::error::operation_aborted) {
+            ReportError(ec, "read"sv);
+        }
+        // ответы на уже прочитанные запросы все равно отправляются
+        return FinishIfDrained();
+    }
+
+    HttpRequest request = parser_->release();
+
+    if (beast::websocket::is_upgrade(request)) {
+        // соединение перейдет к WebSocket, когда уйдут ответы на предыдущие запросы
+        read_closed_ = true;
+        upgrade_request_ = std::move(request);
+        return FinishIfDrained();
+    }
+
+    if (!request.keep_alive()) {
+        read_closed_ = true;
     }
 
-    HandlerRequest(std::move(request_));
+    const std::uint64_t request_id = next_request_id_++;
+    responses_.emplace_back();
+    HandlerRequest(std::move(request), request_id);
+    Read();
 }
 
 void SessionBase::Close() {
-    stream_.socket().shutdown(tcp::socket::shutdown_send);
+    sys::error_code ec;
+    stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+    if (reading_) {
+        stream_.socket().cancel(ec);
+    }
+}
+
+void SessionBase::Enqueue(std::uint64_t request_id, PendingPtr response) {
+    responses_[request_id - first_request_id_] = std::move(response);
+    WriteNext();
+}
+
+void SessionBase::WriteNext() {
+    if (writing_ || write_closed_ || responses_.empty() || !responses_.front()) {
+        return;
+    }
+
+    PendingPtr response = std::move(responses_.front());
+    responses_.pop_front();
+    ++first_request_id_;
+
+    writing_ = true;
+    stream_.expires_after(IO_TIMEOUT);
+    response->Write(*this);
 }
 
 void SessionBase::OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+    writing_ = false;
+
     if (ec) {
+        read_closed_ = write_closed_ = true;
         return ReportError(ec, "write"sv);
     }
 
     if (close) {
-        // Семантика ответа требует закрыть соединение
+        // Семантика ответа требует закрыть соединение, ответы на следующие запросы не отправляются
+        read_closed_ = write_closed_ = true;
         return Close();
     }
 
+    WriteNext();
     Read();
+    FinishIfDrained();
+}
+
+void SessionBase::FinishIfDrained() {
+    if (!read_closed_ || writing_ || !responses_.empty()) {
+        return;
+    }
+
+    if (upgrade_request_) {
+        HttpRequest request = std::move(*upgrade_request_);
+        upgrade_request_.reset();
+        return HandlerUpgrade(std::move(request));
+    }
+    Close();
+}
+
+void SessionBase::WriteMessage(SendfileResponse& response, PendingPtr holder) {
+    using Serializer = http::response_serializer<SendfileBody>;
+    auto serializer = std::allocate_shared<Serializer>(ArenaAllocator<Serializer>{arena_}, response);
+    http::async_write_header(stream_, *serializer,
+                             [&response, holder = std::move(holder), serializer, self = GetSharedThis()](
+                                 beast::error_code ec, std::size_t bytes_written) mutable {
+        if (ec || !response.body().file) {
+            return self->OnWrite(response.need_eof(), ec, bytes_written);
+        }
+        self->SendFile(response, std::move(holder), 0);
+    });
+}
+
+void SessionBase::SendFile(SendfileResponse& response, PendingPtr holder, std::uint64_t offset) {
+    auto& socket = stream_.socket();
+    const auto& body = response.body();
+
+    sys::error_code ec;
+    if (!socket.native_non_blocking()) {
+        socket.native_non_blocking(true, ec);
+    }
+
+    while (!ec && offset < body.size) {
+        off_t file_offset = static_cast<off_t>(offset);
+        const ssize_t sent = ::sendfile(socket.native_handle(), body.file->native_handle(),
+                                        &file_offset, body.size - offset);
+        if (sent > 0) {
+            offset += static_cast<std::uint64_t>(sent);
+        } else if (sent == 0) {
+            // файл укоротился после того, как был отправлен Content-Length
+            ec = net::error::eof;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // сокет заполнен: продолжим, когда в него снова можно писать, но не дольше IO_TIMEOUT
+            send_timer_.expires_after(IO_TIMEOUT);
+            send_timer_.async_wait([self = GetSharedThis()](sys::error_code ec) {
+                if (!ec) {
+                    self->stream_.socket().cancel(ec);
+                }
+            });
+            socket.async_wait(tcp::socket::wait_write,
+                              [&response, holder = std::move(holder), offset, self = GetSharedThis()](
+                                  sys::error_code ec) mutable {
+                if (self->send_timer_.cancel() == 0) {
+                    // таймер уже сработал: клиент не принимал данные IO_TIMEOUT
+                    ec = beast::error::timeout;
+                }
+                if (ec) {
+                    return self->OnWrite(true, ec, offset);
+                }
+                self->SendFile(response, std::move(holder), offset);
+            });
+            return;
+        } else {
+            ec = sys::error_code{errno, sys::system_category()};
+        }
+    }
+
+    OnWrite(response.need_eof(), ec, offset);
 }
 
 net::ip::tcp::endpoint SessionBase::GetRemoteEndpoint() const {
@@ -65,4 +261,9 @@ net::ip::tcp::endpoint SessionBase::GetLocalEndpoint() const {
     return stream_.socket().local_endpoint();
 }
 
+beast::tcp_stream SessionBase::ReleaseStream() {
+    stream_.expires_never();
+    return std::move(stream_);
+}
+
 }  // namespace http_server
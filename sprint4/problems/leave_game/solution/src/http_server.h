@@ -1,14 +1,26 @@
 #pragma once
 #include "sdk.h"
+#include "admission_control.h"
+#include "arena_allocator.h"
+#include "io_context_pool.h"
 #include "logger.h"
 
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/asio/write.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
+#include <boost/beast/websocket/rfc6455.hpp>
+#include <boost/optional.hpp>
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <optional>
+#include <utility>
 
 namespace http_server {
 
@@ -20,6 +32,90 @@ namespace sys = boost::system;
 
 void ReportError(beast::error_code ec, std::string_view what);
 
+// несколько сокетов слушают один порт, ядро раздает между ними входящие соединения.
+// Опция в виде, который ждет set_option: уровень, имя и значение для setsockopt
+class ReusePort {
+public:
+    explicit ReusePort(bool enabled) noexcept
+        : value_(enabled ? 1 : 0) {
+    }
+
+    template <typename Protocol>
+    int level(const Protocol&) const noexcept {
+        return SOL_SOCKET;
+    }
+
+    template <typename Protocol>
+    int name(const Protocol&) const noexcept {
+        return SO_REUSEPORT;
+    }
+
+    template <typename Protocol>
+    const int* data(const Protocol&) const noexcept {
+        return &value_;
+    }
+
+    template <typename Protocol>
+    std::size_t size(const Protocol&) const noexcept {
+        return sizeof(value_);
+    }
+
+private:
+    int value_;
+};
+
+// отказ без сессии и без чтения запроса: готовый 503, после которого соединение закрывается
+void RejectConnection(tcp::socket&& socket);
+
+/* Тело ответа из открытого файла. Сериализатор Beast пишет только заголовок,
+   содержимое сессия отправляет сама через sendfile(2), без копирования в память процесса.
+   Пустой file - ответ на HEAD: уходит только заголовок
+ */
+struct SendfileBody {
+    struct value_type {
+        std::shared_ptr<beast::file> file;
+        std::uint64_t size = 0;
+    };
+
+    static std::uint64_t size(const value_type& body) noexcept {
+        return body.size;
+    }
+
+    class writer {
+    public:
+        using const_buffers_type = net::const_buffer;
+
+        template <bool isRequest, class Fields>
+        writer(const http::header<isRequest, Fields>&, const value_type&) {
+        }
+
+        void init(beast::error_code& ec) {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            return boost::none;
+        }
+    };
+};
+
+using SendfileResponse = http::response<SendfileBody>;
+
+struct SessionLimits {
+    constexpr static std::uint32_t DEFAULT_HEADER_LIMIT = 8 * 1024;
+    constexpr static std::uint64_t DEFAULT_BODY_LIMIT = 1024 * 1024;
+    constexpr static std::size_t DEFAULT_MAX_IN_FLIGHT = 16;
+
+    std::uint32_t header_limit = DEFAULT_HEADER_LIMIT;
+    std::uint64_t body_limit = DEFAULT_BODY_LIMIT;
+    // сколько запросов конвейера прочитано, но еще не получило отправленный ответ
+    std::size_t max_in_flight = DEFAULT_MAX_IN_FLIGHT;
+};
+
+/* HTTP/1.1-сессия с конвейером: следующий запрос читается, не дожидаясь ответа на предыдущий.
+   Ответы могут быть готовы в любом порядке, но отправляются в порядке запросов
+ */
 class SessionBase {
 public:
     SessionBase(const SessionBase&) = delete;
@@ -28,39 +124,112 @@ public:
     void Run();
 
 protected:
-    using HttpRequest = http::request<http::string_body>;
+    // заголовки запроса лежат в пуле соединения, ответ с тем же распределителем попадет туда же
+    using HttpRequest = StringRequest;
 
-    explicit SessionBase(tcp::socket&& socket)
-        : stream_(std::move(socket)) {
+    SessionBase(tcp::socket&& socket, const SessionLimits& limits, AdmissionControl::Ticket&& ticket)
+        : stream_(std::move(socket))
+        , send_timer_(stream_.get_executor())
+        , ticket_(std::move(ticket))
+        , limits_(limits)
+        , arena_(MakeConnectionArena())
+        , responses_(ArenaAllocator<PendingPtr>{arena_}) {
     }
 
     ~SessionBase() = default;
 
+    // request_id - номер запроса, который получил HandlerRequest; можно вызывать из любого потока
     template<typename Body, typename Fields>
-    void Write(http::response<Body, Fields>&& response) {
-        auto safe_response = std::make_shared<http::response<Body, Fields>>(std::move(response));
-        auto self = GetSharedThis();
-        http::async_write(stream_, *safe_response,
-                          [safe_response, self](beast::error_code ec, std::size_t bytes_written) {
-            self->OnWrite(safe_response->need_eof(), ec, bytes_written);
+    void Write(std::uint64_t request_id, http::response<Body, Fields>&& response) {
+        // ответ переносится на strand соединения, там он и ждет своей очереди в памяти из пула
+        net::dispatch(stream_.get_executor(), [self = GetSharedThis(), request_id,
+                                               response = std::move(response)]() mutable {
+            using Pending = PendingMessage<http::response<Body, Fields>>;
+            self->Enqueue(request_id, std::allocate_shared<Pending>(ArenaAllocator<Pending>{self->arena_},
+                                                                    std::move(response)));
         });
     }
 
     net::ip::tcp::endpoint GetRemoteEndpoint() const;
     net::ip::tcp::endpoint GetLocalEndpoint() const;
 
+    // после upgrade соединение обслуживает WebSocket, HTTP-сессия больше не читает из него
+    beast::tcp_stream ReleaseStream();
+
 
 private:
+    // готовый ответ в очереди; живет до конца своей записи, после чего память возвращается в пул
+    class PendingResponse : public std::enable_shared_from_this<PendingResponse> {
+    public:
+        virtual ~PendingResponse() = default;
+        virtual void Write(SessionBase& session) = 0;
+    };
+
+    template <typename Response>
+    class PendingMessage final : public PendingResponse {
+    public:
+        explicit PendingMessage(Response&& response)
+            : response_(std::move(response)) {
+        }
+
+        void Write(SessionBase& session) override {
+            session.WriteMessage(response_, shared_from_this());
+        }
+
+    private:
+        Response response_;
+    };
+
+    using PendingPtr = std::shared_ptr<PendingResponse>;
+
+    constexpr static std::chrono::seconds IO_TIMEOUT{30};
+
     beast::tcp_stream stream_;
+    // sendfile ждет сокет мимо stream_, поэтому его таймаут отмеряет отдельный таймер
+    net::steady_timer send_timer_;
+    // место в лимитах соединений занято, пока жива сессия
+    AdmissionControl::Ticket ticket_;
+    // буфер и место под парсер живут все время соединения
     beast::flat_buffer buffer_;
-    HttpRequest request_;
+    SessionLimits limits_;
+    // объявлен раньше всего, что берет из него память
+    std::shared_ptr<std::pmr::memory_resource> arena_;
+    std::optional<http::request_parser<http::string_body, ArenaAllocator<char>>> parser_;
+
+    // ответы в порядке запросов, пустой слот - ответ еще готовится; front() относится к first_request_id_
+    std::deque<PendingPtr, ArenaAllocator<PendingPtr>> responses_;
+    std::uint64_t first_request_id_ = 0;
+    std::uint64_t next_request_id_ = 0;
+    std::optional<HttpRequest> upgrade_request_;
+
+    bool reading_ = false;
+    bool writing_ = false;
+    // запросов больше не будет: клиент закрыл соединение, ошибка чтения, upgrade или Connection: close
+    bool read_closed_ = false;
+    // ответов больше не будет: ошибка записи или ответ, после которого соединение закрывается
+    bool write_closed_ = false;
 
     void Read();
     void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read);
     void Close();
+    void Enqueue(std::uint64_t request_id, PendingPtr response);
+    void WriteNext();
     void OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written);
+    void FinishIfDrained();
+
+    template<typename Body, typename Fields>
+    void WriteMessage(http::response<Body, Fields>& response, PendingPtr holder) {
+        http::async_write(stream_, response, [&response, holder = std::move(holder), self = GetSharedThis()](
+                                                 beast::error_code ec, std::size_t bytes_written) {
+            self->OnWrite(response.need_eof(), ec, bytes_written);
+        });
+    }
 
-    virtual void HandlerRequest(HttpRequest&& request) = 0;
+    void WriteMessage(SendfileResponse& response, PendingPtr holder);
+    void SendFile(SendfileResponse& response, PendingPtr holder, std::uint64_t offset);
+
+    virtual void HandlerRequest(HttpRequest&& request, std::uint64_t request_id) = 0;
+    virtual void HandlerUpgrade(HttpRequest&& request) = 0;
 
     virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
 };
@@ -69,21 +238,27 @@ template <typename RequestHandler>
 class Session : public SessionBase, public std::enable_shared_from_this<Session<RequestHandler>> {
 public:
     template <typename Handler>
-    Session(tcp::socket&& socket, Handler&& request_handler)
-        : SessionBase(std::move(socket))
+    Session(tcp::socket&& socket, Handler&& request_handler, const SessionLimits& limits,
+            AdmissionControl::Ticket&& ticket)
+        : SessionBase(std::move(socket), limits, std::move(ticket))
         , request_handler_(std::forward<Handler>(request_handler)) {
     }
 
 private:
     RequestHandler request_handler_;
 
-    void HandlerRequest(HttpRequest&& request) override {
+    void HandlerRequest(HttpRequest&& request, std::uint64_t request_id) override {
         request_handler_(std::move(request), GetRemoteEndpoint().address().to_string(),
-                         [self = this->shared_from_this()](auto&& response) {
-            self->Write(std::move(response));
+                         [self = this->shared_from_this(), request_id](auto&& response) {
+            self->Write(request_id, std::move(response));
         });
     }
 
+    void HandlerUpgrade(HttpRequest&& request) override {
+        auto client_ip = GetRemoteEndpoint().address().to_string();
+        request_handler_.Upgrade(std::move(request), client_ip, ReleaseStream());
+    }
+
     std::shared_ptr<SessionBase> GetSharedThis() override {
         return this->shared_from_this();
     }
@@ -93,12 +268,18 @@ template <typename RequestHandler>
 class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
 public:
     template <typename Handler>
-    Listener(net::io_context& io, const tcp::endpoint& endpoint, Handler&& handler)
+    Listener(net::io_context& io, const tcp::endpoint& endpoint, Handler&& handler, const SessionLimits& limits,
+             std::shared_ptr<AdmissionControl> admission, bool reuse_port = false)
         : ioc_(io)
         , acceptor_(net::make_strand(ioc_))
-        , request_handler_(std::forward<Handler>(handler)) {
+        , request_handler_(std::forward<Handler>(handler))
+        , limits_(limits)
+        , admission_(std::move(admission)) {
         acceptor_.open(endpoint.protocol());
         acceptor_.set_option(net::socket_base::reuse_address(true));
+        if (reuse_port) {
+            acceptor_.set_option(ReusePort(true));
+        }
         acceptor_.bind(endpoint);
         acceptor_.listen(net::socket_base::max_listen_connections);
     }
@@ -111,6 +292,8 @@ private:
     net::io_context& ioc_;
     tcp::acceptor acceptor_;
     RequestHandler request_handler_;
+    SessionLimits limits_;
+    std::shared_ptr<AdmissionControl> admission_;
 
     void DoAccept() {
         acceptor_.async_accept(
@@ -122,22 +305,58 @@ private:
     void OnAccept(sys::error_code ec, tcp::socket socket) {
         using namespace std::literals;
         if (ec) {
+            // сокет не открыт, сессию для него не создаем
             ReportError(ec, "accept"sv);
+            admission_->OnAcceptError();
+            return DoAccept();
+        }
+
+        // клиент мог уже отключиться, пока соединение ждало в очереди
+        const tcp::endpoint remote = socket.remote_endpoint(ec);
+        if (ec) {
+            admission_->OnAcceptError();
+            return DoAccept();
         }
 
-        AsyncRunSession(std::move(socket));
+        if (auto ticket = admission_->Admit(remote.address())) {
+            AsyncRunSession(std::move(socket), std::move(*ticket));
+        } else {
+            RejectConnection(std::move(socket));
+        }
         DoAccept();
     }
 
-    void AsyncRunSession(tcp::socket&& socket) {
-        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_)->Run();
+    void AsyncRunSession(tcp::socket&& socket, AdmissionControl::Ticket&& ticket) {
+        std::make_shared<Session<RequestHandler>>(std::move(socket), request_handler_, limits_,
+                                                  std::move(ticket))->Run();
     }
 };
 
+// без admission соединения принимаются без ограничений
 template <typename RequestHandler>
-void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler,
+               const SessionLimits& limits = {}, std::shared_ptr<AdmissionControl> admission = nullptr) {
     using MyListener = Listener<std::decay_t<RequestHandler>>;
-    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+    if (!admission) {
+        admission = std::make_shared<AdmissionControl>(AdmissionLimits{});
+    }
+    std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), limits,
+                                 std::move(admission))->Run();
+}
+
+/* Слушатель со своим SO_REUSEPORT-сокетом на каждом io_context пула: соединение принимается и обслуживается
+   на одном ядре, общего акцептора нет. Обработчик копируется в каждый слушатель, лимиты соединений общие
+ */
+template <typename RequestHandler>
+void ServeHttp(IoContextPool& pool, const tcp::endpoint& endpoint, const RequestHandler& handler,
+               const SessionLimits& limits = {}, std::shared_ptr<AdmissionControl> admission = nullptr) {
+    using MyListener = Listener<RequestHandler>;
+    if (!admission) {
+        admission = std::make_shared<AdmissionControl>(AdmissionLimits{});
+    }
+    for (std::size_t i = 0; i < pool.Size(); ++i) {
+        std::make_shared<MyListener>(pool.Get(i), endpoint, handler, limits, admission, true)->Run();
+    }
 }
 
 }  // namespace http_server
@@ -0,0 +1,91 @@
+#include "io_context_pool.h"
+#include "logger.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace http_server {
+
+using namespace std::literals;
+
+namespace {
+
+// ядра, на которых процессу разрешено работать (например, после taskset - не все)
+std::vector<int> GetAllowedCores() {
+    std::vector<int> cores;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+        for (int core = 0; core < CPU_SETSIZE; ++core) {
+            if (CPU_ISSET(core, &cpus)) {
+                cores.push_back(core);
+            }
+        }
+    }
+    return cores;
+}
+
+// 0 или код ошибки pthread_setaffinity_np
+int PinToCore(std::thread& thread, int core) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+}
+
+}  // namespace
+
+IoContextPool::IoContextPool(std::size_t size) {
+    if (size == 0) {
+        throw std::invalid_argument("IoContextPool size must be positive");
+    }
+    contexts_.reserve(size);
+    work_guards_.reserve(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        // io_context обслуживает ровно один поток
+        contexts_.push_back(std::make_unique<net::io_context>(1));
+        work_guards_.push_back(net::make_work_guard(*contexts_.back()));
+    }
+}
+
+IoContextPool::~IoContextPool() {
+    Stop();
+    Join();
+}
+
+void IoContextPool::Start() {
+    const std::vector<int> cores = GetAllowedCores();
+    threads_.reserve(contexts_.size());
+    for (std::size_t i = 0; i < contexts_.size(); ++i) {
+        threads_.emplace_back([&ioc = *contexts_[i]] {
+            ioc.run();
+        });
+        if (cores.empty()) {
+            continue;
+        }
+        // без закрепления поток все равно работает, только планировщик может переносить его между ядрами
+        if (const int error = PinToCore(threads_.back(), cores[i % cores.size()]); error != 0) {
+            http_logger::LogServerError(error, std::strerror(error), "pin io thread"sv);
+        }
+    }
+}
+
+void IoContextPool::Stop() {
+    for (auto& ioc : contexts_) {
+        ioc->stop();
+    }
+}
+
+void IoContextPool::Join() {
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads_.clear();
+}
+
+}  // namespace http_server
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace http_server {
+
+namespace net = boost::asio;
+
+/* Набор io_context, по одному на ядро. Каждый обслуживает один поток, закрепленный за своим ядром,
+   поэтому соединение, принятое на io_context, до конца живет на одном ядре.
+   С игрой потоки пула общаются только сообщениями: post на strand игры и обратно на executor соединения
+ */
+class IoContextPool {
+public:
+    explicit IoContextPool(std::size_t size);
+    ~IoContextPool();
+
+    IoContextPool(const IoContextPool&) = delete;
+    IoContextPool& operator=(const IoContextPool&) = delete;
+
+    std::size_t Size() const noexcept {
+        return contexts_.size();
+    }
+
+    net::io_context& Get(std::size_t index) {
+        return *contexts_.at(index);
+    }
+
+    // поток i обслуживает io_context i и закреплен за i-м из доступных процессу ядер
+    void Start();
+    // можно вызывать из любого потока, в том числе из обработчика сигнала на другом io_context
+    void Stop();
+    void Join();
+
+private:
+    using WorkGuard = net::executor_work_guard<net::io_context::executor_type>;
+
+    std::vector<std::unique_ptr<net::io_context>> contexts_;
+    // без гарантии работы io_context вернулся бы из run(), пока на нем еще нет ни одного слушателя
+    std::vector<WorkGuard> work_guards_;
+    std::vector<std::thread> threads_;
+};
+
+}  // namespace http_server
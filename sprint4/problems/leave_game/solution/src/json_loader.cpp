@@ -127,6 +127,10 @@ model::Game LoadGame(const std::filesystem::path& json_path) {
     if (game_info.as_object().count("dogRetirementTime"sv)) {
         game.SetRetirementTime(game_info.at("dogRetirementTime"sv).as_double());
     }
+
+    if (game_info.as_object().count("maxPlayersPerSession"sv)) {
+        game.SetMaxPlayersPerSession(json::value_to<size_t>(game_info.at("maxPlayersPerSession"sv)));
+    }
     return game;
 }
 
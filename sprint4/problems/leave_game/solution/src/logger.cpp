@@ -29,7 +29,7 @@ void LogFormatter(logging::record_view const& rec, logging::formatting_ostream&
         {"message", *rec[expr::smessage]}
     };
 
-    strm << boost::json::serialize(log);
+    strm << boost::json::serialize(log) << '\n';
 }
 
 void LogServerStart(unsigned int port, std::string_view address) {
@@ -61,4 +61,47 @@ void LogServerError(unsigned int error_code, std::string_view error_message, std
     BOOST_LOG_TRIVIAL(info) << logging::add_value(log_data, data) << "error";
 }
 
+void LogSessionTickTimes(boost::json::array session_tick_times) {
+    boost::json::value data = {
+        {"sessions", std::move(session_tick_times)}
+    };
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(log_data, data) << "session tick times";
+}
+
+void LogDroppedTickTime(std::int64_t dropped_ms, std::int64_t simulated_ms, std::int64_t total_dropped_ms) {
+    boost::json::value data = {
+        {"dropped_ms", dropped_ms},
+        {"simulated_ms", simulated_ms},
+        {"total_dropped_ms", total_dropped_ms}
+    };
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(log_data, data) << "tick time dropped";
+}
+
+void LogSlowTick(boost::json::value tick_phases) {
+    BOOST_LOG_TRIVIAL(warning) << logging::add_value(log_data, std::move(tick_phases)) << "slow tick";
+}
+
+void LogStateSaved(std::int64_t stall_us, std::int64_t duration_us, std::uintmax_t bytes, bool background) {
+    boost::json::value data = {
+        {"stall_us", stall_us},
+        {"duration_us", duration_us},
+        {"bytes", bytes},
+        {"background", background}
+    };
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(log_data, data) << "state saved";
+}
+
+void LogConnectionsShed(std::uint64_t accepted, std::uint64_t active, std::uint64_t rejected_connections,
+                        std::uint64_t rejected_per_ip, std::uint64_t rejected_overload, std::uint64_t accept_errors) {
+    boost::json::value data = {
+        {"accepted", accepted},
+        {"active", active},
+        {"rejected_connections", rejected_connections},
+        {"rejected_per_ip", rejected_per_ip},
+        {"rejected_overload", rejected_overload},
+        {"accept_errors", accept_errors}
+    };
+    BOOST_LOG_TRIVIAL(warning) << logging::add_value(log_data, data) << "connections shed";
+}
+
 } // namespace http_logger
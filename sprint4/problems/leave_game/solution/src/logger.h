@@ -6,6 +6,7 @@
 #include <boost/log/trivial.hpp>
 #include <boost/log/core.hpp>
 #include <boost/log/expressions.hpp>
+#include <boost/log/sinks/auto_newline_mode.hpp>
 #include <boost/log/utility/manipulators/add_value.hpp>
 #include <boost/log/utility/setup/common_attributes.hpp>
 #include <boost/log/utility/setup/console.hpp>
@@ -14,6 +15,8 @@
 #include <iostream>
 #include <string_view>
 
+#include "async_log.h"
+
 namespace logging = boost::log;
 namespace keywords = boost::log::keywords;
 namespace http = boost::beast::http;
@@ -42,9 +45,12 @@ template <typename Formatter>
 void InitBoostLogFilter(Formatter&& formatter) {
     logging::add_common_attributes();
     
+    // перевод строки дописывает форматтер: строка уходит в поток одной записью
+    // и не перемешивается с пачками AsyncLog, которые пишутся в тот же std::cout
     logging::add_console_log(
         std::cout,
         keywords::format = &formatter,
+        keywords::auto_newline_mode = logging::sinks::auto_newline_mode::disabled_auto_newline,
         keywords::auto_flush = true
     );
 }
@@ -53,12 +59,25 @@ template<class RequestHandler>
 class LogginRequestHandler {
 public:
 
-    explicit LogginRequestHandler(RequestHandler& request_handler)
-        : decorated_(request_handler) {
+    LogginRequestHandler(RequestHandler& request_handler, AsyncLog& log)
+        : decorated_(request_handler)
+        , log_(log) {
+    }
+
+    template <typename Request, typename Stream>
+    void Upgrade(Request&& req, std::string_view client_ip, Stream&& stream) {
+        if (log_.Sample()) {
+            LogRequest(client_ip, req);
+        }
+        decorated_.Upgrade(std::forward<Request>(req), std::forward<Stream>(stream));
     }
 
     template <typename Request, typename Send>
     void operator()(Request&& req, std::string_view client_ip, Send&& send) {
+        if (!log_.Sample()) {
+            decorated_(std::forward<Request>(req), std::forward<Send>(send));
+            return;
+        }
         DurationMeasure dur;
         LogRequest(client_ip, req);
         decorated_(std::forward<decltype(req)>(req), [this, send = std::forward<Send>(send),
@@ -70,15 +89,13 @@ public:
 
 private:
     RequestHandler& decorated_;
+    // запросы пишутся в кольцо потока, форматирует и выводит их фоновый поток журнала
+    AsyncLog& log_;
 
     template <typename Request>
     void LogRequest(std::string_view client_ip, Request& request) const {
-        boost::json::value data = {
-            {"ip", client_ip},
-            {"URI", request.target()},
-            {"method", http::to_string(request.method())}
-        };
-        BOOST_LOG_TRIVIAL(info) << logging::add_value(log_data, data) << "request received";
+        const auto target = request.target();
+        log_.LogRequest(client_ip, {target.data(), target.size()}, request.method());
     }
 
     template <typename Response>
@@ -87,12 +104,7 @@ private:
         if (content_type.empty()) {
             content_type = "null";
         }
-        boost::json::value data = {
-            {"response_time", time},
-            {"code", response.result_int()},
-            {"content_type", content_type}
-        };
-        BOOST_LOG_TRIVIAL(info) << logging::add_value(log_data, data) << "response sent";
+        log_.LogResponse(time, response.result_int(), {content_type.data(), content_type.size()});
     }
 };
 
@@ -101,4 +113,10 @@ private:
 void LogServerStart(unsigned int port, std::string_view address);
 void LogServerEnd(unsigned int return_code, std::string_view exeption_text);
 void LogServerError(unsigned int error_code, std::string_view error_message, std::string_view where);
+void LogSessionTickTimes(boost::json::array session_tick_times);
+void LogDroppedTickTime(std::int64_t dropped_ms, std::int64_t simulated_ms, std::int64_t total_dropped_ms);
+void LogSlowTick(boost::json::value tick_phases);
+void LogStateSaved(std::int64_t stall_us, std::int64_t duration_us, std::uintmax_t bytes, bool background);
+void LogConnectionsShed(std::uint64_t accepted, std::uint64_t active, std::uint64_t rejected_connections,
+                        std::uint64_t rejected_per_ip, std::uint64_t rejected_overload, std::uint64_t accept_errors);
 } // namespace http_logger
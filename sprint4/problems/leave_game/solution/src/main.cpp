@@ -8,10 +8,12 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <thread>
 
 #include "app.h"
 #include "cl_parser.h"
+#include "io_context_pool.h"
 #include "json_loader.h"
 #include "./leaderboard/leaderboard.h"
 #include "logger.h"
@@ -49,6 +51,7 @@ void RunWorkers(unsigned n, const Fn& fn) {
 }
 
 constexpr const char DB_URL_ENV_NAME[]{"GAME_DB_URL"};
+constexpr std::chrono::milliseconds TICK_TIMES_REPORT_PERIOD = 1s;
 
 leaderboard::LeaderboardConfig GetConfigFromEnv() {
     leaderboard::LeaderboardConfig config;
@@ -62,6 +65,18 @@ leaderboard::LeaderboardConfig GetConfigFromEnv() {
     return config;
 }
 
+void LogSessionTickTimes(const std::vector<model::SessionTickTime>& tick_times) {
+    boost::json::array sessions;
+    for (const auto& [map_id, session_id, phases] : tick_times) {
+        sessions.push_back({
+            {"map", *map_id},
+            {"session", *session_id},
+            {"tick_time_us", std::chrono::duration_cast<std::chrono::microseconds>(phases.Total()).count()}
+        });
+    }
+    http_logger::LogSessionTickTimes(std::move(sessions));
+}
+
 }  // namespace
 
 int main(int argc, const char* argv[]) {
@@ -85,6 +100,12 @@ int main(int argc, const char* argv[]) {
         if (cl_args.random_spawn_point) {
             game.TurnOnRandomSpawn();
         }
+        game.SetTickWorkers(cl_args.tick_workers);
+        game.SetFixedTimestep(cl_args.max_tick_step, cl_args.max_tick_catch_up);
+        app.SetTickBudget(std::chrono::milliseconds{cl_args.tick_budget});
+        if (cl_args.random_seed) {
+            game.SetRandomSeed(*cl_args.random_seed);
+        }
 
         std::shared_ptr<serialization::SerializationListener> listener{nullptr};
         if (!cl_args.state_file.empty()) {
@@ -108,7 +129,15 @@ int main(int argc, const char* argv[]) {
                 std::filesystem::create_directories(state_file_path.parent_path());
             }
             listener = std::make_shared<serialization::SerializationListener>
-                (std::chrono::milliseconds{cl_args.save_state_period}, &app, cl_args.state_file);
+                (std::chrono::milliseconds{cl_args.save_state_period}, &app, cl_args.state_file, cl_args.background_save);
+            listener->SetReportHandler([](const serialization::SaveReport& report) {
+                if (!report.error.empty()) {
+                    http_logger::LogServerError(EXIT_FAILURE, report.error, "save"sv);
+                    return;
+                }
+                http_logger::LogStateSaved(report.stall.count(), report.duration.count(), report.bytes,
+                                           report.background);
+            });
         }
         app.SetListener(listener.get());
 
@@ -121,28 +150,50 @@ int main(int argc, const char* argv[]) {
 
         // 2. Инициализируем io_context
         const unsigned num_threads = std::thread::hardware_concurrency();
-        net::io_context ioc(num_threads);
+        // в режиме io_context на ядро ioc остается за игрой: strand, тики, сигналы;
+        // соединения обслуживает пул, его потоки приходят в игру только через post на strand
+        std::optional<http_server::IoContextPool> io_pool;
+        if (cl_args.io_per_core) {
+            io_pool.emplace(std::max(1u, num_threads));
+        }
+        net::io_context ioc(io_pool ? 1 : num_threads);
 
         // 3. Добавляем асинхронный обработчик сигналов SIGINT и SIGTERM
         net::signal_set signals(ioc, SIGINT, SIGTERM);
-        signals.async_wait([&ioc](const boost::system::error_code& ec, [[maybe_unused]] int signal_number) {
+        signals.async_wait([&ioc, &io_pool](const boost::system::error_code& ec, [[maybe_unused]] int signal_number) {
             if (!ec) {
                 ioc.stop();
+                if (io_pool) {
+                    io_pool->Stop();
+                }
             }
         });
 
         // 4. Создаём обработчик HTTP-запросов и связываем его с моделью игры
         auto game_state_strand = net::make_strand(ioc);
+        // кеш статики ждет inotify и перечитывает каталог: в режиме io_context на ядро это работа пула, а не игры
+        net::io_context& static_ioc = io_pool ? io_pool->Get(io_pool->Size() - 1) : ioc;
 
-        auto handler = std::make_shared<http_handler::RequestHandler>(app, ioc, game_state_strand,
+        auto handler = std::make_shared<http_handler::RequestHandler>(app, static_ioc, game_state_strand,
                                                                       std::move(cl_args.static_root), !(static_cast<bool>(cl_args.tick_period)));
         http_logger::InitBoostLogFilter(http_logger::LogFormatter);
-        http_logger::LogginRequestHandler<http_handler::RequestHandler> logging_handler(*handler);
+        http_logger::AsyncLog access_log{std::cout, {.sample_rate = cl_args.log_sample_rate}};
+        http_logger::LogginRequestHandler<http_handler::RequestHandler> logging_handler(*handler, access_log);
 
+        std::shared_ptr<tick::Ticker> ticker;
         if (cl_args.tick_period != 0) {
             auto tick_period = std::chrono::milliseconds{cl_args.tick_period};
-            auto ticker = std::make_shared<tick::Ticker>(game_state_strand, tick_period, [&app](std::chrono::milliseconds delta) {
-                app.ProcessTick(delta.count());
+            ticker = std::make_shared<tick::Ticker>(game_state_strand, tick_period,
+                                                    [&app, &game, time_since_report = 0ms](std::chrono::milliseconds delta) mutable {
+                auto report = app.ProcessTick(delta.count());
+                http_handler::LogTickReport(app, report);
+
+                // в параллельном режиме раз в секунду сообщаем время тика каждой сессии
+                time_since_report += delta;
+                if (game.GetTickWorkers() > 1 && time_since_report >= TICK_TIMES_REPORT_PERIOD) {
+                    time_since_report = 0ms;
+                    LogSessionTickTimes(game.GetSessionTickTimes());
+                }
             });
             ticker->Start();
         }
@@ -150,20 +201,52 @@ int main(int argc, const char* argv[]) {
         // 5. Запустить обработчик HTTP-запросов, делегируя их обработчику запросов
         const auto address = net::ip::make_address("0.0.0.0");
         constexpr net::ip::port_type port = 8080;
-        http_server::ServeHttp(ioc, {address, port}, logging_handler);
+        http_server::SessionLimits session_limits;
+        if (cl_args.max_pipelined_requests != 0) {
+            session_limits.max_in_flight = cl_args.max_pipelined_requests;
+        }
+        if (cl_args.request_header_limit != 0) {
+            session_limits.header_limit = cl_args.request_header_limit;
+        }
+        if (cl_args.request_body_limit != 0) {
+            session_limits.body_limit = cl_args.request_body_limit;
+        }
+
+        // новых клиентов не берем, пока strand игры или тики не успевают за уже подключенными
+        http_server::AdmissionLimits admission_limits{cl_args.max_connections, cl_args.max_connections_per_ip};
+        auto admission = std::make_shared<http_server::AdmissionControl>(admission_limits,
+            [handler, ticker, max_api_queue = cl_args.max_api_queue,
+             max_tick_lag = std::chrono::milliseconds{cl_args.max_tick_lag}] {
+                return (max_api_queue != 0 && handler->GetApiQueueDepth() > max_api_queue)
+                    || (ticker && max_tick_lag != 0ms && ticker->GetLag() > max_tick_lag);
+            });
+        if (io_pool) {
+            http_server::ServeHttp(*io_pool, {address, port}, logging_handler, session_limits, admission);
+        } else {
+            http_server::ServeHttp(ioc, {address, port}, logging_handler, session_limits, admission);
+        }
 
         // Эта надпись сообщает тестам о том, что сервер запущен и готов обрабатывать запросы
         http_logger::LogServerStart(port, address.to_string());
 
         // 6. Запускаем обработку асинхронных операций
-        RunWorkers(std::max(1u, num_threads), [&ioc] {
+        if (io_pool) {
+            io_pool->Start();
             ioc.run();
-        });
+            io_pool->Stop();
+            io_pool->Join();
+        } else {
+            RunWorkers(std::max(1u, num_threads), [&ioc] {
+                ioc.run();
+            });
+        }
 
         if (listener) {
             listener->Serialize();
         }
 
+        // журнал запросов дописывается раньше сообщения о завершении
+        access_log.Stop();
         http_logger::LogServerEnd(0, ""sv);
     } catch (const std::exception& ex) {
         http_logger::LogServerEnd(EXIT_FAILURE, ex.what());
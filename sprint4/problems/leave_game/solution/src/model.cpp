@@ -2,13 +2,59 @@
 
 #include <algorithm>
 #include <iostream>
+#include <boost/asio/post.hpp>
+
 #include <cmath>
+#include <exception>
+#include <latch>
+#include <limits>
 #include <random>
 #include <stdexcept>
 
 namespace model {
 using namespace std::literals;
 
+namespace {
+
+void InsertCorridor(std::vector<RoadCorridor>& corridors, RoadCorridor corridor) {
+    // сливаем новый отрезок со всеми, которые он перекрывает или которых касается
+    auto first = std::lower_bound(corridors.begin(), corridors.end(), corridor.from,
+                                  [](const RoadCorridor& lhs, double from) {
+        return lhs.to < from;
+    });
+    auto last = first;
+    while (last != corridors.end() && last->from <= corridor.to) {
+        corridor.from = std::min(corridor.from, last->from);
+        corridor.to = std::max(corridor.to, last->to);
+        ++last;
+    }
+    corridors.insert(corridors.erase(first, last), corridor);
+}
+
+const RoadCorridor* FindCorridor(const std::unordered_map<geom::Coord, std::vector<RoadCorridor>>& lines,
+                                 geom::Coord line, double coord) {
+    auto it = lines.find(line);
+    if (it == lines.end()) {
+        return nullptr;
+    }
+    const auto& corridors = it->second;
+    auto corridor = std::lower_bound(corridors.begin(), corridors.end(), coord,
+                                     [](const RoadCorridor& lhs, double coord) {
+        return lhs.to < coord;
+    });
+    if (corridor == corridors.end() || corridor->from > coord) {
+        return nullptr;
+    }
+    return &*corridor;
+}
+
+bool IsZeroSpeed(const geom::Vec2D& speed) {
+    return std::fabs(speed.x) < std::numeric_limits<double>::epsilon()
+        && std::fabs(speed.y) < std::numeric_limits<double>::epsilon();
+}
+
+} // namespace
+
 std::string DirectionToString(Direction dir) {
     switch (dir) {
         case Direction::NORTH:
@@ -60,23 +106,19 @@ bool Road::IsDogOnRoad(geom::Point2D dog_point) const {
 }
 
 double Road::GetLeftEdge() const {
-    double border_offset = 0.4;
-    return std::min(start_.x, end_.x) - border_offset;
+    return std::min(start_.x, end_.x) - HALF_WIDTH;
 }
 
 double Road::GetRightEdge() const {
-    double border_offset = 0.4;
-    return std::max(start_.x, end_.x) + border_offset;
+    return std::max(start_.x, end_.x) + HALF_WIDTH;
 }
 
 double Road::GetUpperEdge() const {
-    double border_offset = 0.4;
-    return std::min(start_.y, end_.y) - border_offset;
+    return std::min(start_.y, end_.y) - HALF_WIDTH;
 }
 
 double Road::GetBottomEdge() const {
-    double border_offset = 0.4;
-    return std::max(start_.y, end_.y) + border_offset;
+    return std::max(start_.y, end_.y) + HALF_WIDTH;
 }
 
 const geom::Rectangle& Building::GetBounds() const noexcept {
@@ -143,10 +185,15 @@ void Map::AddRoad(Road&& road) {
     roads_.push_back(std::move(road));
     Road& new_road = roads_.back();
     if (new_road.IsVertical()) {
-        vertical_road_index_[new_road.GetStart().x].push_back(&new_road);
+        InsertCorridor(column_corridors_[new_road.GetStart().x],
+                       {new_road.GetUpperEdge(), new_road.GetBottomEdge()});
     } else {
-        horizontal_road_index_[new_road.GetStart().y].push_back(&new_road);
+        InsertCorridor(row_corridors_[new_road.GetStart().y],
+                       {new_road.GetLeftEdge(), new_road.GetRightEdge()});
     }
+    const double road_length = std::abs(new_road.GetEnd().x - new_road.GetStart().x)
+                             + std::abs(new_road.GetEnd().y - new_road.GetStart().y);
+    road_length_cdf_.push_back((road_length_cdf_.empty() ? 0. : road_length_cdf_.back()) + road_length);
 }
 
 void Map::AddBuilding(Building&& building) {
@@ -178,27 +225,36 @@ void Map::SetBagCapacity(size_t bag_capacity) {
     bag_capacity_ = bag_capacity;
 }
 
-geom::Point2D Map::GetRandomPoint() const {
+geom::Point2D Map::GetRandomPoint(RandomEngine& engine) const {
     if (roads_.size() == 0) {
         throw std::logic_error("No roads on map to generate random road"s);
     }
 
-    std::random_device random_device;
-    std::mt19937 generator{random_device()};
-
-    std::uniform_int_distribution int_dist(0, static_cast<int>(roads_.size() - 1));
-
-    const Road& rand_road = roads_.at(int_dist(generator));
+    const double total_length = road_length_cdf_.back();
+    if (total_length == 0.) {
+        // на карте только дороги нулевой длины
+        std::uniform_int_distribution<size_t> road_dist(0, roads_.size() - 1);
+        const geom::Point start = roads_[road_dist(engine)].GetStart();
+        return {static_cast<double>(start.x), static_cast<double>(start.y)};
+    }
 
-    if (rand_road.IsHorizontal()) {
-        std::uniform_real_distribution double_dist(std::min(rand_road.GetStart().x, rand_road.GetEnd().x) + 0.0,
-                                                   std::max(rand_road.GetStart().x, rand_road.GetEnd().x) + 0.0);
-        return {static_cast<double>(double_dist(generator)), static_cast<double>(rand_road.GetStart().y)};
+    // одно число задает и дорогу, и смещение вдоль нее
+    std::uniform_real_distribution<double> length_dist(0., total_length);
+    const double offset = length_dist(engine);
+    const size_t road_index = std::min(static_cast<size_t>(std::upper_bound(road_length_cdf_.begin(),
+                                                                            road_length_cdf_.end(), offset)
+                                                           - road_length_cdf_.begin()),
+                                       roads_.size() - 1);
+    const Road& road = roads_[road_index];
+    const double road_begin = road_index == 0 ? 0. : road_length_cdf_[road_index - 1];
+    const double along = std::min(offset - road_begin, road_length_cdf_[road_index] - road_begin);
+
+    const geom::Point start = road.GetStart();
+    const geom::Point end = road.GetEnd();
+    if (road.IsHorizontal()) {
+        return {std::min(start.x, end.x) + along, static_cast<double>(start.y)};
     }
-    
-    std::uniform_real_distribution double_dist(std::min(rand_road.GetStart().y, rand_road.GetEnd().y) + 0.0,
-                                               std::max(rand_road.GetStart().y, rand_road.GetEnd().y) + 0.0);
-    return {static_cast<double>(rand_road.GetStart().x), static_cast<double>(double_dist(generator))};
+    return {static_cast<double>(start.x), std::min(start.y, end.y) + along};
 }
 
 geom::Point2D Map::GetDefaultSpawnPoint() const {
@@ -207,37 +263,219 @@ geom::Point2D Map::GetDefaultSpawnPoint() const {
             static_cast<double>(first_road_start.y)};
 }
 
-const Road* Map::GetVerticalRoad(geom::Point2D dog_point) const {
-    geom::Point map_point = ConvertToMapPoint(dog_point);
+RoadMove Map::MoveAlongRoads(geom::Point2D from, geom::Point2D to, Direction direction) const {
+    const bool horizontal = direction == Direction::EAST || direction == Direction::WEST;
+    const RoadCorridor corridor = horizontal ? GetCorridor(from.x, from.y, true)
+                                             : GetCorridor(from.y, from.x, false);
 
-    if (vertical_road_index_.contains(map_point.x)) {
-        const auto& roads = vertical_road_index_.at(map_point.x);
-        return *std::find_if(roads.begin(), roads.end(), [&dog_point](const Road* road) {
-            return road->IsDogOnRoad(dog_point);
-        });
+    RoadMove move{to, false};
+    double& along = horizontal ? move.position.x : move.position.y;
+    if (along > corridor.to) {
+        along = corridor.to;
+        move.stopped = true;
+    } else if (along < corridor.from) {
+        along = corridor.from;
+        move.stopped = true;
     }
-    return nullptr;
+    return move;
 }
 
-const Road* Map::GetHorizontalRoad(geom::Point2D dog_point) const {
-    geom::Point map_point = ConvertToMapPoint(dog_point);
-    if (horizontal_road_index_.contains(map_point.y)) {
-        const auto& roads = horizontal_road_index_.at(map_point.y);
-        return *std::find_if(roads.begin(), roads.end(), [&dog_point](const Road* road) {
-            return road->IsDogOnRoad(dog_point);
-        });
+RoadCorridor Map::GetCorridor(double along, double across, bool horizontal) const {
+    const auto& lines = horizontal ? row_corridors_ : column_corridors_;
+    const auto& cross_lines = horizontal ? column_corridors_ : row_corridors_;
+
+    // собака в полосе своей линии и на одной из ее дорог
+    const auto line = static_cast<geom::Coord>(std::round(across));
+    if (across >= line - Road::HALF_WIDTH && across <= line + Road::HALF_WIDTH) {
+        if (const RoadCorridor* corridor = FindCorridor(lines, line, along)) {
+            return *corridor;
+        }
     }
-    return nullptr;
+
+    /* иначе собака стоит на перпендикулярной дороге. Перпендикулярная дорога не может
+       продлить коридор линии: ее полоса либо внутри коридора, либо отделена зазором.
+       Поэтому двигаться можно только в пределах ее ширины
+     */
+    const auto cross_line = static_cast<geom::Coord>(std::round(along));
+    if (along >= cross_line - Road::HALF_WIDTH && along <= cross_line + Road::HALF_WIDTH
+        && FindCorridor(cross_lines, cross_line, across) != nullptr) {
+        return {cross_line - Road::HALF_WIDTH, cross_line + Road::HALF_WIDTH};
+    }
+
+    throw std::logic_error("invalid dog position");
+}
+
+DogStore::Handle DogStore::Add(geom::Point2D pos, geom::Vec2D speed, size_t bag_capacity) {
+    Handle handle;
+    if (!free_handles_.empty()) {
+        handle = free_handles_.back();
+        free_handles_.pop_back();
+    } else {
+        handle = static_cast<Handle>(handle_to_index_.size());
+        handle_to_index_.push_back(0);
+    }
+
+    handle_to_index_[handle] = static_cast<std::uint32_t>(positions_.size());
+    index_to_handle_.push_back(handle);
+    positions_.push_back(pos);
+    prev_positions_.push_back(pos);
+    speeds_.push_back(speed);
+    directions_.push_back(Direction::NORTH);
+    bags_.emplace_back(bag_capacity);
+    scores_.push_back(0);
+    changed_versions_.push_back(pending_version_);
+    ++revision_;
+    return handle;
+}
+
+void DogStore::Remove(Handle handle) {
+    const size_t index = GetIndex(handle);
+    const size_t last = positions_.size() - 1;
+
+    if (index != last) {
+        positions_[index] = positions_[last];
+        prev_positions_[index] = prev_positions_[last];
+        speeds_[index] = speeds_[last];
+        directions_[index] = directions_[last];
+        bags_[index] = std::move(bags_[last]);
+        scores_[index] = scores_[last];
+        changed_versions_[index] = changed_versions_[last];
+        index_to_handle_[index] = index_to_handle_[last];
+        handle_to_index_[index_to_handle_[index]] = static_cast<std::uint32_t>(index);
+    }
+
+    positions_.pop_back();
+    prev_positions_.pop_back();
+    speeds_.pop_back();
+    directions_.pop_back();
+    bags_.pop_back();
+    scores_.pop_back();
+    changed_versions_.pop_back();
+    index_to_handle_.pop_back();
+    free_handles_.push_back(handle);
+    ++revision_;
+}
+
+size_t DogStore::Size() const noexcept {
+    return positions_.size();
+}
+
+size_t DogStore::GetIndex(Handle handle) const {
+    return handle_to_index_.at(handle);
+}
+
+std::vector<geom::Point2D>& DogStore::GetPositions() noexcept {
+    return positions_;
+}
+
+const std::vector<geom::Point2D>& DogStore::GetPositions() const noexcept {
+    return positions_;
+}
+
+std::vector<geom::Point2D>& DogStore::GetPreviousPositions() noexcept {
+    return prev_positions_;
+}
+
+const std::vector<geom::Point2D>& DogStore::GetPreviousPositions() const noexcept {
+    return prev_positions_;
+}
+
+std::vector<geom::Vec2D>& DogStore::GetSpeeds() noexcept {
+    return speeds_;
+}
+
+const std::vector<geom::Vec2D>& DogStore::GetSpeeds() const noexcept {
+    return speeds_;
+}
+
+std::vector<Direction>& DogStore::GetDirections() noexcept {
+    return directions_;
+}
+
+const std::vector<Direction>& DogStore::GetDirections() const noexcept {
+    return directions_;
+}
+
+std::vector<game_obj::Bag<Loot>>& DogStore::GetBags() noexcept {
+    return bags_;
+}
+
+const std::vector<game_obj::Bag<Loot>>& DogStore::GetBags() const noexcept {
+    return bags_;
 }
 
-std::vector<const Road*> Map::GetRelevantRoads(geom::Point2D dog_point) const {
-    std::vector<const Road*> relevant_road;
-    for (auto& road : roads_) {
-        if (road.IsDogOnRoad(dog_point)) {
-            relevant_road.push_back(&road);
+std::vector<std::uint16_t>& DogStore::GetScores() noexcept {
+    return scores_;
+}
+
+const std::vector<std::uint16_t>& DogStore::GetScores() const noexcept {
+    return scores_;
+}
+
+std::uint64_t DogStore::GetRevision() const noexcept {
+    return revision_;
+}
+
+void DogStore::MarkChanged(size_t index) noexcept {
+    changed_versions_[index] = pending_version_;
+    ++revision_;
+}
+
+void DogStore::SetPendingVersion(std::uint64_t version) noexcept {
+    pending_version_ = version;
+}
+
+const std::vector<std::uint64_t>& DogStore::GetChangedVersions() const noexcept {
+    return changed_versions_;
+}
+
+Dog::Dog(Id id, std::string name, geom::Point2D pos, geom::Vec2D speed, size_t bag_capacity)
+    : Dog(std::make_shared<DogStore>(), std::move(id), std::move(name), pos, speed, bag_capacity) {
+}
+
+Dog::Dog(std::shared_ptr<DogStore> store, Id id, std::string name, geom::Point2D pos,
+         geom::Vec2D speed, size_t bag_capacity)
+    : id_(std::move(id))
+    , name_(std::move(name))
+    , store_(std::move(store))
+    , handle_(store_->Add(pos, speed, bag_capacity)) {
+}
+
+Dog::Dog(Dog&& other) noexcept
+    : id_(std::move(other.id_))
+    , name_(std::move(other.name_))
+    , store_(std::move(other.store_))
+    , handle_(other.handle_) {
+}
+
+Dog& Dog::operator=(Dog&& other) noexcept {
+    if (this != &other) {
+        if (store_) {
+            store_->Remove(handle_);
         }
+        id_ = std::move(other.id_);
+        name_ = std::move(other.name_);
+        store_ = std::move(other.store_);
+        handle_ = other.handle_;
+    }
+    return *this;
+}
+
+Dog::~Dog() {
+    if (store_) {
+        store_->Remove(handle_);
     }
-    return relevant_road;
+}
+
+bool Dog::operator==(const Dog& other) const {
+    return id_ == other.id_
+        && name_ == other.name_
+        && GetPosition() == other.GetPosition()
+        && GetPreviousPosition() == other.GetPreviousPosition()
+        && GetSpeed() == other.GetSpeed()
+        && GetDirection() == other.GetDirection()
+        && *GetBag() == *other.GetBag()
+        && GetScore() == other.GetScore();
 }
 
 const std::string& Dog::GetName() const noexcept {
@@ -250,123 +488,178 @@ const Dog::Id& Dog::GetId() const noexcept {
 
 void Dog::SetName(std::string_view name) {
     name_ = std::string(name);
+    store_->MarkChanged(GetIndex());
 }
 
 void Dog::SetPosition(geom::Point2D new_pos) {
-    prev_pos_ = pos_;
-    pos_ = new_pos;
+    const size_t index = GetIndex();
+    store_->GetPreviousPositions()[index] = store_->GetPositions()[index];
+    store_->GetPositions()[index] = new_pos;
+    store_->MarkChanged(index);
 }
 
 const geom::Point2D& Dog::GetPosition() const {
-    return pos_;
+    return store_->GetPositions()[GetIndex()];
 }
 
 const geom::Point2D& Dog::GetPreviousPosition() const {
-    return prev_pos_;
+    return store_->GetPreviousPositions()[GetIndex()];
 }
 
 void Dog::SetSpeed(geom::Vec2D new_speed) {
-    speed_ = new_speed;
+    const size_t index = GetIndex();
+    store_->GetSpeeds()[index] = new_speed;
+    store_->MarkChanged(index);
 }
 
 const geom::Vec2D& Dog::GetSpeed() const {
-    return speed_;
+    return store_->GetSpeeds()[GetIndex()];
 }
 
 void Dog::SetDirection(Direction new_dir) {
-    dir_ = new_dir;
+    const size_t index = GetIndex();
+    store_->GetDirections()[index] = new_dir;
+    store_->MarkChanged(index);
 }
 
 Direction Dog::GetDirection() const {
-    return dir_;
-
+    return store_->GetDirections()[GetIndex()];
 }
 
 double Dog::GetWidth() const noexcept {
-    return width_;
+    return WIDTH;
 }
 
 void Dog::Stop() {
-    speed_ = {0, 0};
+    SetSpeed({0, 0});
 }
 
 bool Dog::IsStopped() const {
-    return std::fabs(speed_.x) < std::numeric_limits<double>::epsilon()
-        && std::fabs(speed_.y) < std::numeric_limits<double>::epsilon();
+    return IsZeroSpeed(GetSpeed());
+}
+
+void Dog::Move(std::optional<Direction> direction, double speed) {
+    if (!direction) {
+        Stop();
+        return;
+    }
+    switch (*direction) {
+        case Direction::WEST:
+            SetSpeed({-speed, 0});
+            break;
+        case Direction::EAST:
+            SetSpeed({speed, 0});
+            break;
+        case Direction::NORTH:
+            SetSpeed({0, -speed});
+            break;
+        case Direction::SOUTH:
+            SetSpeed({0, speed});
+            break;
+    }
+    SetDirection(*direction);
 }
 
 game_obj::Bag<Loot>* Dog::GetBag() {
-    return &bag_;
+    return &store_->GetBags()[GetIndex()];
+}
+
+const game_obj::Bag<Loot>* Dog::GetBag() const {
+    return &store_->GetBags()[GetIndex()];
 }
 
 void Dog::AddScore(std::uint16_t score_to_add) {
-    score_ += score_to_add;
+    const size_t index = GetIndex();
+    store_->GetScores()[index] += score_to_add;
+    store_->MarkChanged(index);
 }
 
 std::uint16_t Dog::GetScore() const {
-    return score_;
+    return store_->GetScores()[GetIndex()];
 }
 
-LootOfficeDogProvider::LootOfficeDogProvider(const Map::Offices& offices) {
-    for (const auto& office : offices) {
-        items_.push_back(&office);
+DogStore::Handle Dog::GetHandle() const noexcept {
+    return handle_;
+}
+
+void Dog::MoveToStore(std::shared_ptr<DogStore> store) {
+    if (store == store_) {
+        return;
     }
+
+    const size_t old_index = GetIndex();
+    auto& old_bag = store_->GetBags()[old_index];
+    DogStore::Handle new_handle = store->Add(store_->GetPositions()[old_index], store_->GetSpeeds()[old_index],
+                                             old_bag.GetCapacity());
+    const size_t new_index = store->GetIndex(new_handle);
+    store->GetPreviousPositions()[new_index] = store_->GetPreviousPositions()[old_index];
+    store->GetDirections()[new_index] = store_->GetDirections()[old_index];
+    store->GetBags()[new_index] = std::move(old_bag);
+    store->GetScores()[new_index] = store_->GetScores()[old_index];
+
+    store_->Remove(handle_);
+    store_ = std::move(store);
+    handle_ = new_handle;
+}
+
+size_t Dog::GetIndex() const {
+    return store_->GetIndex(handle_);
+}
+
+LootOfficeDogProvider::LootOfficeDogProvider(const Map::Offices& offices, const LootStore* loot, const DogStore* dogs)
+    : offices_(&offices)
+    , loot_(loot)
+    , dogs_(dogs) {
 }
 
 size_t LootOfficeDogProvider::ItemsCount() const {
-    return items_.size();
+    return offices_->size() + loot_->Size();
 }
 
 collision_detector::Item LootOfficeDogProvider::GetItem(size_t idx) const {
-    if (std::holds_alternative<const Office*>(items_.at(idx))) {
-        const Office* office_ptr = std::get<const Office*>(items_.at(idx));
-        const geom::Point& position = office_ptr->GetPosition();
-        return {{static_cast<double>(position.x), static_cast<double>(position.y)}, office_ptr->GetWidth()};
-    } else if (std::holds_alternative<const Loot*>(items_.at(idx))) {
-        const Loot* loot = std::get<const Loot*>(items_.at(idx));
-        double item_width = 0.;
-        return {loot->point, item_width};
-    } else {
-        throw std::logic_error("unknown variant type");
+    if (IsOffice(idx)) {
+        const Office& office = (*offices_)[idx];
+        const geom::Point& position = office.GetPosition();
+        return {{static_cast<double>(position.x), static_cast<double>(position.y)}, office.GetWidth()};
     }
+    double item_width = 0.;
+    return {GetLoot(idx).point, item_width};
 }
 
 size_t LootOfficeDogProvider::GatherersCount() const {
-    return gatherers_.size();
+    return dogs_->Size();
 }
 
 collision_detector::Gatherer LootOfficeDogProvider::GetGatherer(size_t idx) const {
-    auto dog = gatherers_.at(idx);
-    return {dog->GetPreviousPosition(), dog->GetPosition(), dog->GetWidth()};
+    return {dogs_->GetPreviousPositions()[idx], dogs_->GetPositions()[idx], Dog::WIDTH};
 }
 
-void LootOfficeDogProvider::PushBackLoot(const Loot* loot) {
-    items_.push_back(loot);
+bool LootOfficeDogProvider::IsOffice(size_t idx) const noexcept {
+    return idx < offices_->size();
 }
 
-void LootOfficeDogProvider::EraseLoot(size_t idx) {
-    items_.erase(items_.begin() + idx);
+const Loot& LootOfficeDogProvider::GetLoot(size_t idx) const {
+    return loot_->GetValues().at(idx - offices_->size());
 }
 
-const std::variant<const Office*, const Loot*>& LootOfficeDogProvider::GetRawLootVal(size_t idx) const {
-    return items_.at(idx);
-
+LootStore::Handle LootOfficeDogProvider::GetLootHandle(size_t idx) const {
+    return loot_->GetHandle(idx - offices_->size());
 }
 
-void LootOfficeDogProvider::AddGatherer(Dog* gatherer) {
-    gatherers_.push_back(gatherer);
+void LootOfficeDogProvider::ResetTaken() {
+    taken_.assign(ItemsCount(), false);
 }
 
-void LootOfficeDogProvider::EraseGatherer(Dog* gatherer) {
-    gatherers_.erase(std::find(gatherers_.begin(), gatherers_.end(), gatherer));
+bool LootOfficeDogProvider::IsTaken(size_t idx) const {
+    return taken_[idx];
 }
 
-const Dog* LootOfficeDogProvider::GetDog(size_t idx) const {
-    return gatherers_.at(idx);
+void LootOfficeDogProvider::MarkTaken(size_t idx) {
+    taken_[idx] = true;
 }
 
-Dog* LootOfficeDogProvider::GetDog(size_t idx) {
-    return gatherers_.at(idx);
+const GameSession::Id& GameSession::GetId() const noexcept {
+    return id_;
 }
 
 const Map::Id& GameSession::GetMapId() const {
@@ -377,12 +670,16 @@ const model::Map* GameSession::GetMap() const {
     return map_;
 }
 
+size_t GameSession::GetDogsCount() const noexcept {
+    return dogs_.size();
+}
+
 Dog* GameSession::AddDog(std::string_view name) {
     geom::Vec2D default_speed = {0, 0};
 
     geom::Point2D start_point;
     if (random_dog_spawn_) {
-        start_point = map_->GetRandomPoint();
+        start_point = map_->GetRandomPoint(random_engine_);
     } else {
         start_point = map_->GetDefaultSpawnPoint();
     }
@@ -390,16 +687,35 @@ Dog* GameSession::AddDog(std::string_view name) {
     geom::Point2D dog_pos = {static_cast<double>(start_point.x),
                                 static_cast<double>(start_point.y)}; // map_->GetRandomDogPoint();
 
-    auto dog = std::make_shared<Dog>(Dog::Id{next_dog_id_++}, std::string(name), dog_pos, default_speed, map_->GetBagCapacity());
+    auto dog = std::make_shared<Dog>(dog_store_, Dog::Id{next_dog_id_++}, std::string(name), dog_pos, default_speed,
+                                     map_->GetBagCapacity());
     auto dog_id = dog->GetId();
     dogs_.emplace(dog_id, dog);
-    items_gatherer_provider_.AddGatherer(dog.get());
     return dogs_.at(dog_id).get();
 }
 
 void GameSession::DeleteDog(const Dog::Id& id) {
-    items_gatherer_provider_.EraseGatherer(dogs_.at(id).get());
-    dogs_.erase(id);
+    const Dog::Id dog_id = id; // id может ссылаться на поле удаляемой собаки
+    if (dogs_.erase(dog_id) != 0) { // собака сама освобождает свое место в dog_store_
+        state_history_.back().removed_dogs.push_back(dog_id);
+    }
+}
+
+bool GameSession::PostCommand(const DogCommand& command) const noexcept {
+    return commands_->TryPush(command);
+}
+
+size_t GameSession::ApplyCommands() {
+    size_t applied = 0;
+    DogCommand command;
+    while (commands_->TryPop(command)) {
+        // id собак в сессии не переиспользуются, поэтому команда не попадет к чужой собаке
+        if (auto dog = dogs_.find(command.dog_id); dog != dogs_.end()) {
+            dog->second->Move(command.direction, map_->GetSpeed());
+            ++applied;
+        }
+    }
+    return applied;
 }
 
 const Dog* GameSession::GetDog(Dog::Id id) const {
@@ -414,18 +730,101 @@ const GameSession::IdToDogIndex& GameSession::GetDogs() const {
     return dogs_;
 }
 
-const GameSession::IdToLootIndex& GameSession::GetAllLoot() const {
-    return loot_;
+const DogStore& GameSession::GetDogStore() const {
+    return *dog_store_;
+}
+
+const std::vector<Loot>& GameSession::GetAllLoot() const {
+    return loot_->GetValues();
+}
+
+std::uint64_t GameSession::GetRevision() const noexcept {
+    // оба счетчика только растут, поэтому сумма меняется при любом изменении
+    return revision_ + dog_store_->GetRevision();
+}
+
+std::uint64_t GameSession::GetStateVersion() const noexcept {
+    return state_version_;
+}
+
+bool GameSession::IsStateDeltaAvailable(std::uint64_t since) const noexcept {
+    // нужны записи всех версий после since, включая незавершенную
+    return since <= state_version_ && state_history_.front().version <= since + 1;
+}
+
+StateDelta GameSession::GetStateDelta(std::uint64_t since) const {
+    StateDelta delta;
+    delta.version = state_version_;
+    delta.full = !IsStateDeltaAvailable(since);
+
+    const auto& changed_versions = dog_store_->GetChangedVersions();
+    for (const auto& [_, dog] : dogs_) {
+        if (delta.full || changed_versions[dog_store_->GetIndex(dog->GetHandle())] > since) {
+            delta.changed_dogs.push_back(dog.get());
+        }
+    }
+
+    std::uint32_t first_new_loot_id = 0;
+    if (!delta.full) {
+        const auto& since_changes = state_history_[since + 1 - state_history_.front().version];
+        first_new_loot_id = since_changes.first_loot_id;
+
+        for (auto it = state_history_.begin() + static_cast<std::ptrdiff_t>(since + 1 - state_history_.front().version);
+             it != state_history_.end(); ++it) {
+            delta.removed_dogs.insert(delta.removed_dogs.end(), it->removed_dogs.begin(), it->removed_dogs.end());
+            delta.removed_loot.insert(delta.removed_loot.end(), it->removed_loot.begin(), it->removed_loot.end());
+        }
+    }
+    // лут в хранилище не упорядочен по id, новый отбирается одним проходом по плотному массиву
+    for (const Loot& loot : loot_->GetValues()) {
+        if (*loot.id >= first_new_loot_id) {
+            delta.added_loot.push_back(&loot);
+        }
+    }
+    return delta;
 }
 
-void GameSession::EraseLoot(Loot::Id loot_id) {
-    loot_.erase(loot_id);
+void GameSession::StartStateVersion() {
+    state_history_.push_back({state_version_ + 1, next_loot_id_, {}, {}});
+    while (state_history_.size() > STATE_HISTORY_LENGTH + 1) {
+        state_history_.pop_front();
+    }
+    dog_store_->SetPendingVersion(state_version_ + 1);
 }
 
 void GameSession::UpdateState(std::int64_t tick) {
+    using Clock = std::chrono::steady_clock;
+
+    const auto start = Clock::now();
     UpdateDogsState(tick);
+    const auto moved = Clock::now();
     GenerateLoot(tick);
+    const auto generated = Clock::now();
     HandleCollisions();
+
+    last_tick_times_.movement += moved - start;
+    last_tick_times_.loot_generation += generated - moved;
+    last_tick_times_.collisions += Clock::now() - generated;
+    ++revision_;
+
+    ++state_version_;
+    StartStateVersion();
+}
+
+void GameSession::ResetTickTimes() noexcept {
+    last_tick_times_ = {};
+}
+
+const SessionPhaseTimes& GameSession::GetLastTickTimes() const noexcept {
+    return last_tick_times_;
+}
+
+std::chrono::nanoseconds GameSession::GetLastTickDuration() const noexcept {
+    return last_tick_times_.Total();
+}
+
+void GameSession::SetRandomSeed(std::uint64_t seed) {
+    random_engine_.seed(seed);
 }
 
 std::uint32_t GameSession::GetNextDogId() const {
@@ -436,18 +835,26 @@ std::uint32_t GameSession::GetNextLootId() const {
     return next_loot_id_;
 }
 
-void GameSession::Restore(IdToDogIndex&& dogs, std::uint32_t next_dog_id, IdToLootIndex&& loot, std::uint32_t next_loot_id) {
+void GameSession::Restore(IdToDogIndex&& dogs, std::uint32_t next_dog_id, std::vector<Loot>&& loot, std::uint32_t next_loot_id,
+                          std::uint64_t state_version) {
+    // истории до сохранения нет: любой since до state_version получит полное состояние
+    state_version_ = state_version;
+    state_history_.clear();
+    dog_store_->SetPendingVersion(state_version_ + 1);
+
     dogs_ = std::forward<IdToDogIndex>(dogs);
     next_dog_id_ = next_dog_id;
     for (auto& [_, dog] : dogs_) {
-        items_gatherer_provider_.AddGatherer(dog.get());
+        dog->MoveToStore(dog_store_);
     }
 
-    loot_ = std::forward<IdToLootIndex>(loot);
-    for (auto [_, loot] : loot_) {
-        items_gatherer_provider_.PushBackLoot(loot.get());
+    *loot_ = LootStore{};
+    for (Loot& item : loot) {
+        loot_->Insert(std::move(item));
     }
     next_loot_id_ = next_loot_id;
+    ++revision_;
+    StartStateVersion();
 }
 
 
@@ -455,105 +862,75 @@ void GameSession::UpdateDogsState(std::int64_t tick) {
     double ms_convertion = 0.001; // 1ms = 0.001s
     double tick_multy = static_cast<double>(tick) * ms_convertion;
 
-    for (auto [_, dog] : dogs_) {
-        if (dog->IsStopped()) {
-            continue;
-        }
-
-        auto cur_dog_pos = dog->GetPosition();
-        auto dog_speed = dog->GetSpeed();
-        geom::Point2D new_dog_pos = {cur_dog_pos.x + (dog_speed.x * tick_multy),
-            cur_dog_pos.y + (dog_speed.y * tick_multy)};
-
-        auto relevant_road = map_->GetRelevantRoads(cur_dog_pos);
-        if (relevant_road.empty()) {
-            throw std::logic_error("invalid dog position");
-        }
+    auto& positions = dog_store_->GetPositions();
+    auto& prev_positions = dog_store_->GetPreviousPositions();
+    auto& speeds = dog_store_->GetSpeeds();
+    const auto& directions = dog_store_->GetDirections();
+    const size_t dogs_count = dog_store_->Size();
+
+    // сначала интегрируем позиции всех собак одним плотным циклом без ветвлений,
+    // компилятор может его векторизовать
+    next_positions_.resize(dogs_count);
+    for (size_t i = 0; i < dogs_count; ++i) {
+        next_positions_[i].x = positions[i].x + (speeds[i].x * tick_multy);
+        next_positions_[i].y = positions[i].y + (speeds[i].y * tick_multy);
+    }
 
-        geom::Point2D relevant_point = cur_dog_pos;
-        bool stopped = true;
-
-        for (auto road : relevant_road) {
-            if (road->IsDogOnRoad(new_dog_pos)) {
-                relevant_point = new_dog_pos;
-                stopped = false;
-                break;
-            } else {
-
-                switch (dog->GetDirection()) {
-                    case Direction::NORTH:
-                        if (road->GetUpperEdge() < relevant_point.y) {
-                            relevant_point = {relevant_point.x, road->GetUpperEdge()};
-                        }
-                        break;
-                    case Direction::SOUTH:
-                        if (road->GetBottomEdge() > relevant_point.y) {
-                            relevant_point = {relevant_point.x, road->GetBottomEdge()};
-                        }
-                        break;
-                    case Direction::EAST:
-                        if (road->GetRightEdge() > relevant_point.x) {
-                            relevant_point = {road->GetRightEdge(), relevant_point.y};
-                        }
-                        break;
-                    case Direction::WEST:
-                        if (road->GetLeftEdge() < relevant_point.x) {
-                            relevant_point = {road->GetLeftEdge(), relevant_point.y};
-                        }
-                        break;
-                    default:
-                        throw std::logic_error("unknown dog direction");
-                        break;
-                }
-            }
+    // затем движущиеся собаки проверяют, не вышли ли они за пределы дорог
+    for (size_t i = 0; i < dogs_count; ++i) {
+        if (IsZeroSpeed(speeds[i])) {
+            continue;
         }
 
-        dog->SetPosition(relevant_point);
-        if (stopped) {
-            dog->Stop();
+        const RoadMove move = map_->MoveAlongRoads(positions[i], next_positions_[i], directions[i]);
+        prev_positions[i] = positions[i];
+        positions[i] = move.position;
+        if (move.stopped) {
+            speeds[i] = {0, 0};
         }
+        dog_store_->MarkChanged(i);
     }
 }
 
 void GameSession::HandleCollisions() {
     auto gather_events = collision_detector::FindGatherEvents(items_gatherer_provider_);
 
-    std::vector<size_t> items_to_erase;
+    items_gatherer_provider_.ResetTaken();
+    taken_loot_.clear();
     for (const auto& event : gather_events) {
-        game_obj::Bag<Loot>* gatherer_bag = items_gatherer_provider_.GetDog(event.gatherer_id)->GetBag();
-        if (std::holds_alternative<const Office*>(items_gatherer_provider_.GetRawLootVal(event.item_id))) {
+        game_obj::Bag<Loot>* gatherer_bag = &dog_store_->GetBags()[event.gatherer_id];
+        if (items_gatherer_provider_.IsOffice(event.item_id)) {
             if (!gatherer_bag->Empty()) {
                 for (size_t i = 0; i < gatherer_bag->GetSize(); ++i) {
                     auto loot = gatherer_bag->TakeTopLoot();
-                    items_gatherer_provider_.GetDog(event.gatherer_id)->AddScore(map_->GetLootScore(loot.type));
+                    dog_store_->GetScores()[event.gatherer_id] += static_cast<std::uint16_t>(map_->GetLootScore(loot.type));
                 }
+                dog_store_->MarkChanged(event.gatherer_id);
             }
-        } else if (std::holds_alternative<const Loot*>(items_gatherer_provider_.GetRawLootVal(event.item_id))) {
-            if (std::find(items_to_erase.begin(), items_to_erase.end(), event.item_id) == items_to_erase.end()) {
-                const Loot* taking_loot = std::get<const Loot*>(items_gatherer_provider_.GetRawLootVal(event.item_id));
-                if (gatherer_bag->PickUpLoot(*taking_loot)) {
-                    items_to_erase.push_back(event.item_id);
-                }
+        } else if (!items_gatherer_provider_.IsTaken(event.item_id)) {
+            if (gatherer_bag->PickUpLoot(items_gatherer_provider_.GetLoot(event.item_id))) {
+                dog_store_->MarkChanged(event.gatherer_id);
+                items_gatherer_provider_.MarkTaken(event.item_id);
+                taken_loot_.push_back(items_gatherer_provider_.GetLootHandle(event.item_id));
             }
         }
     }
-    // убираем из provider и session весь лишний лут
-    for (size_t id : items_to_erase) {
-        loot_.erase(std::get<const Loot*>(items_gatherer_provider_.GetRawLootVal(id))->id);
-        items_gatherer_provider_.EraseLoot(id);
+    // индексы предметов меняются при каждом swap-remove, поэтому удаляем по handle
+    for (LootStore::Handle handle : taken_loot_) {
+        state_history_.back().removed_loot.push_back(loot_->Get(handle).id);
+        loot_->Erase(handle);
+        ++revision_;
     }
 }
 
 void GameSession::GenerateLoot(std::int64_t tick) {
     loot_gen::LootGenerator::TimeInterval time_interval(tick);
-    unsigned loot_counter = loot_generator_.Generate(time_interval, static_cast<unsigned>(loot_.size()), static_cast<unsigned>(dogs_.size()));
-    std::random_device dev;
-    std::mt19937 rng(dev());
-    std::uniform_int_distribution<std::mt19937::result_type> dist(0, static_cast<unsigned>(map_->GetLootTypes().size() - 1));
+    unsigned loot_counter = loot_generator_.Generate(time_interval, static_cast<unsigned>(loot_->Size()), static_cast<unsigned>(dogs_.size()));
+    std::uniform_int_distribution<unsigned> type_dist(0, static_cast<unsigned>(map_->GetLootTypes().size() - 1));
     for (; loot_counter != 0; --loot_counter) {
-        auto loot_ptr = std::make_shared<Loot>(Loot::Id{next_loot_id_++}, static_cast<uint8_t>(dist(rng)), map_->GetRandomPoint());
-        loot_.insert({loot_ptr->id, loot_ptr});
-        items_gatherer_provider_.PushBackLoot(loot_ptr.get());
+        const Loot::Id loot_id{next_loot_id_++};
+        loot_->Insert(Loot{loot_id, static_cast<std::uint8_t>(type_dist(random_engine_)),
+                           map_->GetRandomPoint(random_engine_)});
     }
 }
 
@@ -584,11 +961,31 @@ const Map* Game::FindMap(const Map::Id& id) const noexcept {
 }
 
 GameSession& Game::StartGameSession(const Map* map) {
-    using namespace std::chrono_literals;
-    if (sessions_[map->GetId()].empty()) {
-        sessions_[map->GetId()].push_back(std::make_shared<GameSession>(map, random_dog_spawn_, loot_config_));
+    auto& map_sessions = sessions_[map->GetId()];
+    auto session = std::make_shared<GameSession>(map, random_dog_spawn_, loot_config_,
+                                                 GameSession::Id{next_session_id_++});
+    if (random_seed_) {
+        session->SetRandomSeed(*random_seed_ + *session->GetId());
+    }
+    map_sessions.push_back(std::move(session));
+    return *map_sessions.back();
+}
+
+GameSession& Game::GetSessionForNewPlayer(const Map* map) {
+    GameSession* least_loaded = nullptr;
+    for (auto& session : sessions_[map->GetId()]) {
+        if (max_players_per_session_ != 0 && session->GetDogsCount() >= max_players_per_session_) {
+            continue;
+        }
+        if (least_loaded == nullptr || session->GetDogsCount() < least_loaded->GetDogsCount()) {
+            least_loaded = session.get();
+        }
+    }
+
+    if (least_loaded == nullptr) {
+        return StartGameSession(map);
     }
-    return *sessions_[map->GetId()].back();
+    return *least_loaded;
 }
 
 const GameSession* Game::GetGameSession(Map::Id map_id) const {
@@ -602,6 +999,23 @@ GameSession* Game::GetGameSession(Map::Id map_id) {
     return const_cast<GameSession*>(static_cast<const Game&>(*this).GetGameSession(map_id)); // по Майерсу
 }
 
+const GameSession* Game::GetGameSession(Map::Id map_id, GameSession::Id session_id) const {
+    auto it = sessions_.find(map_id);
+    if (it == sessions_.end()) {
+        return nullptr;
+    }
+    for (const auto& session : it->second) {
+        if (session->GetId() == session_id) {
+            return session.get();
+        }
+    }
+    return nullptr;
+}
+
+GameSession* Game::GetGameSession(Map::Id map_id, GameSession::Id session_id) {
+    return const_cast<GameSession*>(static_cast<const Game&>(*this).GetGameSession(map_id, session_id));
+}
+
 const Game::SessionsByMaps& Game::GetAllSessions() const {
     return sessions_;
 }
@@ -609,6 +1023,20 @@ const Game::SessionsByMaps& Game::GetAllSessions() const {
 
 void Game::RestoreSessions(SessionsByMaps&& restoring_sessions) {
     sessions_ = std::move(restoring_sessions);
+    next_session_id_ = 0;
+    for (const auto& [_, map_sessions] : sessions_) {
+        for (const auto& session : map_sessions) {
+            next_session_id_ = std::max(next_session_id_, *session->GetId() + 1);
+        }
+    }
+}
+
+void Game::SetMaxPlayersPerSession(size_t max_players) {
+    max_players_per_session_ = max_players;
+}
+
+size_t Game::GetMaxPlayersPerSession() const noexcept {
+    return max_players_per_session_;
 }
 
 void Game::TurnOnRandomSpawn() {
@@ -648,12 +1076,132 @@ bool Game::IsDogSpawnRandom() const {
     return random_dog_spawn_;
 }
 
+void Game::SetRandomSeed(std::uint64_t seed) {
+    random_seed_ = seed;
+}
+
+std::optional<std::uint64_t> Game::GetRandomSeed() const noexcept {
+    return random_seed_;
+}
+
+
+void Game::SetTickWorkers(unsigned workers_count) {
+    tick_workers_ = workers_count;
+    if (tick_pool_) {
+        tick_pool_->join();
+        tick_pool_.reset();
+    }
+    if (tick_workers_ > 1) {
+        tick_pool_ = std::make_unique<net::thread_pool>(tick_workers_);
+    }
+}
+
+unsigned Game::GetTickWorkers() const noexcept {
+    return tick_workers_;
+}
+
+void Game::SetFixedTimestep(std::int64_t max_step_ms, std::int64_t max_catch_up_ms) {
+    max_tick_step_ = std::max<std::int64_t>(max_step_ms, 0);
+    max_tick_catch_up_ = std::max<std::int64_t>(max_catch_up_ms, 0);
+}
+
+std::int64_t Game::ClampTickDelta(std::int64_t tick) const noexcept {
+    if (max_tick_catch_up_ > 0 && tick > max_tick_catch_up_) {
+        return max_tick_catch_up_;
+    }
+    return tick;
+}
+
+std::chrono::milliseconds Game::GetDroppedTime() const noexcept {
+    return dropped_time_;
+}
+
+size_t Game::ApplyCommands() {
+    size_t applied = 0;
+    for (auto& [_, map_sessions] : sessions_) {
+        for (auto& session : map_sessions) {
+            applied += session->ApplyCommands();
+        }
+    }
+    return applied;
+}
+
+TickReport Game::UpdateState(std::int64_t tick) {
+    TickReport report;
+    const std::int64_t simulated = ClampTickDelta(tick);
+    report.simulated = std::chrono::milliseconds{simulated};
+    report.dropped = std::chrono::milliseconds{tick - simulated};
+    dropped_time_ += report.dropped;
+    report.total_dropped = dropped_time_;
+
+    for (auto& [_, map_sessions] : sessions_) {
+        for (auto& session : map_sessions) {
+            session->ResetTickTimes();
+        }
+    }
+
+    // короткие шаги: собаки не перепрыгивают повороты, а отрезки для сбора лута остаются короткими
+    std::int64_t remaining = simulated;
+    do {
+        const std::int64_t step = max_tick_step_ > 0 ? std::min(remaining, max_tick_step_) : remaining;
+        UpdateSessions(step);
+        remaining -= step;
+        ++report.steps;
+    } while (remaining > 0);
+
+    return report;
+}
+
+void Game::UpdateSessions(std::int64_t tick) {
+    if (tick_pool_) {
+        UpdateSessionsInParallel(tick);
+        return;
+    }
 
-void Game::UpdateState(std::int64_t tick) {
     for (auto& [_, map_sessions] : sessions_) {
-        for (auto session : map_sessions) {
+        for (auto& session : map_sessions) {
             session->UpdateState(tick);
         }
     }
 }
+
+void Game::UpdateSessionsInParallel(std::int64_t tick) {
+    std::vector<GameSession*> sessions;
+    for (auto& [_, map_sessions] : sessions_) {
+        for (auto& session : map_sessions) {
+            sessions.push_back(session.get());
+        }
+    }
+
+    std::vector<std::exception_ptr> errors(sessions.size());
+    std::latch sessions_done(static_cast<std::ptrdiff_t>(sessions.size()));
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        net::post(*tick_pool_, [session = sessions[i], &error = errors[i], &sessions_done, tick] {
+            try {
+                session->UpdateState(tick);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            sessions_done.count_down();
+        });
+    }
+    // ждем все сессии: после возврата состояние игры соответствует концу тика
+    sessions_done.wait();
+
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+std::vector<SessionTickTime> Game::GetSessionTickTimes() const {
+    std::vector<SessionTickTime> tick_times;
+    for (const auto& [map_id, map_sessions] : sessions_) {
+        for (const auto& session : map_sessions) {
+            tick_times.push_back({map_id, session->GetId(), session->GetLastTickTimes()});
+        }
+    }
+    return tick_times;
+}
 }  // namespace model
@@ -2,12 +2,15 @@
 
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/strand.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <atomic>
+#include <chrono>
 #include <cmath>
 #include <deque>
 #include <map>
 #include <memory>
 #include <numeric>
+#include <optional>
 #include <random>
 #include <string>
 #include <string_view>
@@ -20,10 +23,15 @@
 #include "game_objects.h"
 #include "geom.h"
 #include "loot_generator.h"
+#include "mpsc_queue.h"
+#include "slot_map.h"
 #include "tagged.h"
 
 namespace model {
 
+// у каждой игровой сессии свой генератор, чтобы сессии не делили состояние между потоками
+using RandomEngine = std::mt19937_64;
+
 enum class Direction {
     NORTH, SOUTH, WEST, EAST
 };
@@ -42,6 +50,7 @@ class Road {
 public:
     constexpr static HorizontalTag HORIZONTAL{};
     constexpr static VerticalTag VERTICAL{};
+    constexpr static double HALF_WIDTH = 0.4;
 
     Road(HorizontalTag, geom::Point start, geom::Coord end_x) noexcept;
     Road(VerticalTag, geom::Point start, geom::Coord end_y) noexcept;
@@ -63,6 +72,18 @@ private:
     geom::Point end_;
 };
 
+// отрезок [from, to] вдоль линии дорог, сплошь покрытый дорогами этой линии (с учетом ширины)
+struct RoadCorridor {
+    double from;
+    double to;
+};
+
+// итог перемещения собаки по дорогам: конечная точка и признак упора в край дороги
+struct RoadMove {
+    geom::Point2D position;
+    bool stopped = false;
+};
+
 class Building {
 public:
     explicit Building(geom::Rectangle bounds) noexcept
@@ -127,18 +148,19 @@ public:
     void AddLootType(extra_data::LootType&& loot_type, unsigned score);
     void SetBagCapacity(size_t bag_capacity);
 
-    geom::Point2D GetRandomPoint() const;
+    // точка выбирается равномерно по суммарной длине дорог
+    geom::Point2D GetRandomPoint(RandomEngine& engine) const;
     geom::Point2D GetDefaultSpawnPoint() const;
 
-    const Road* GetVerticalRoad(geom::Point2D dog_point) const;
-    const Road* GetHorizontalRoad(geom::Point2D dog_point) const;
-
-    std::vector<const Road*> GetRelevantRoads(geom::Point2D dog_point) const;
+    /* перемещает собаку из from в to в направлении direction. Дороги одной линии слиты
+       в коридоры при загрузке карты, поэтому точка остановки - один поиск и одно сравнение
+     */
+    RoadMove MoveAlongRoads(geom::Point2D from, geom::Point2D to, Direction direction) const;
 
 private:
     using OfficeIdToIndex = std::unordered_map<Office::Id, size_t, util::TaggedHasher<Office::Id>>;
-    using VerticalRoadIndex = std::unordered_map<geom::Coord, std::vector<const Road*>>;
-    using HorizontalRoadIndex = std::unordered_map<geom::Coord, std::vector<const Road*>>;
+    // коридоры линии отсортированы и не пересекаются
+    using LineToCorridors = std::unordered_map<geom::Coord, std::vector<RoadCorridor>>;
 
     Id id_;
     std::string name_;
@@ -146,8 +168,9 @@ private:
     size_t bag_capacity_ = 3;
 
     Roads roads_;
-    VerticalRoadIndex vertical_road_index_;
-    HorizontalRoadIndex horizontal_road_index_;
+    std::vector<double> road_length_cdf_; // накопленная длина дорог в порядке roads_
+    LineToCorridors row_corridors_;    // горизонтальные дороги по y
+    LineToCorridors column_corridors_; // вертикальные дороги по x
 
     Buildings buildings_;
 
@@ -156,6 +179,8 @@ private:
 
     std::vector<extra_data::LootType> loot_types_;
     std::unordered_map<std::uint8_t, unsigned> loot_type_to_score_;
+
+    RoadCorridor GetCorridor(double along, double across, bool horizontal) const;
 };
 
 namespace net = boost::asio;
@@ -170,21 +195,80 @@ struct Loot {
     auto operator<=>(const Loot&) const = default;
 };
 
+// DogStore - плотное хранилище состояния собак сессии в виде struct of arrays.
+// Тик обходит массивы подряд, без хеш-таблиц и shared_ptr. Handle собаки стабилен
+// все время ее жизни, а плотный индекс может меняться при удалении (swap-remove)
+class DogStore {
+public:
+    using Handle = std::uint32_t;
+
+    Handle Add(geom::Point2D pos, geom::Vec2D speed, size_t bag_capacity);
+    void Remove(Handle handle);
+
+    size_t Size() const noexcept;
+    size_t GetIndex(Handle handle) const;
+
+    std::vector<geom::Point2D>& GetPositions() noexcept;
+    const std::vector<geom::Point2D>& GetPositions() const noexcept;
+    std::vector<geom::Point2D>& GetPreviousPositions() noexcept;
+    const std::vector<geom::Point2D>& GetPreviousPositions() const noexcept;
+    std::vector<geom::Vec2D>& GetSpeeds() noexcept;
+    const std::vector<geom::Vec2D>& GetSpeeds() const noexcept;
+    std::vector<Direction>& GetDirections() noexcept;
+    const std::vector<Direction>& GetDirections() const noexcept;
+    std::vector<game_obj::Bag<Loot>>& GetBags() noexcept;
+    const std::vector<game_obj::Bag<Loot>>& GetBags() const noexcept;
+    std::vector<std::uint16_t>& GetScores() noexcept;
+    const std::vector<std::uint16_t>& GetScores() const noexcept;
+
+    // растет при каждом изменении собак через Dog, по нему кешируется отрисованное состояние
+    std::uint64_t GetRevision() const noexcept;
+    // собака index изменилась: она попадет в дельту состояния как измененная в pending-версии
+    void MarkChanged(size_t index) noexcept;
+    // версия состояния сессии, в которой станут видны текущие изменения
+    void SetPendingVersion(std::uint64_t version) noexcept;
+    const std::vector<std::uint64_t>& GetChangedVersions() const noexcept;
+
+private:
+    std::vector<geom::Point2D> positions_;
+    std::vector<geom::Point2D> prev_positions_;
+    std::vector<geom::Vec2D> speeds_;
+    std::vector<Direction> directions_;
+    std::vector<game_obj::Bag<Loot>> bags_;
+    std::vector<std::uint16_t> scores_;
+    std::vector<std::uint64_t> changed_versions_;
+
+    std::vector<Handle> index_to_handle_;
+    std::vector<std::uint32_t> handle_to_index_;
+    std::vector<Handle> free_handles_;
+    std::uint64_t revision_ = 0;
+    std::uint64_t pending_version_ = 1;
+};
+
+// Dog - стабильный дескриптор собаки: имя и id хранятся в объекте,
+// а изменяемое на каждом тике состояние - в DogStore сессии
 class Dog {
 public:
     using Id = util::Tagged<std::uint32_t, Dog>;
 
+    constexpr static double WIDTH = 0.6;
+
+    // собака со своим собственным хранилищем (используется при восстановлении и в тестах)
     explicit Dog(Id id, std::string name, geom::Point2D pos, geom::Vec2D speed,
-                 size_t bag_capacity) noexcept
-        : id_(std::move(id))
-        , name_(std::move(name))
-        , pos_(pos)
-        , prev_pos_(pos)
-        , speed_(speed)
-        , bag_(bag_capacity) {
-    }
+                 size_t bag_capacity);
+
+    explicit Dog(std::shared_ptr<DogStore> store, Id id, std::string name, geom::Point2D pos,
+                 geom::Vec2D speed, size_t bag_capacity);
+
+    Dog(const Dog&) = delete;
+    Dog& operator=(const Dog&) = delete;
 
-    auto operator<=>(const Dog&) const = default;
+    Dog(Dog&& other) noexcept;
+    Dog& operator=(Dog&& other) noexcept;
+
+    ~Dog();
+
+    bool operator==(const Dog& other) const;
 
     const std::string& GetName() const noexcept;
     const Id& GetId() const noexcept;
@@ -201,22 +285,32 @@ public:
 
     void Stop();
     bool IsStopped() const;
+    // nullopt - остановиться, иначе бежать в направлении direction со скоростью speed
+    void Move(std::optional<Direction> direction, double speed);
 
     game_obj::Bag<Loot>* GetBag();
+    const game_obj::Bag<Loot>* GetBag() const;
     void AddScore(std::uint16_t score_to_add);
     std::uint16_t GetScore() const;
 
+    DogStore::Handle GetHandle() const noexcept;
+    // переносит состояние собаки в другое хранилище (например, в хранилище сессии)
+    void MoveToStore(std::shared_ptr<DogStore> store);
+
 private:
     Id id_;
     std::string name_;
-    geom::Point2D pos_;
-    geom::Point2D prev_pos_;
-    geom::Vec2D speed_;
-    Direction dir_ = Direction::NORTH;
-    double width_ = 0.6;
-
-    game_obj::Bag<Loot> bag_;
-    std::uint16_t score_ = 0;
+
+    std::shared_ptr<DogStore> store_;
+    DogStore::Handle handle_ = 0;
+
+    size_t GetIndex() const;
+};
+
+// команда игрока, которая ждет ближайшего тика
+struct DogCommand {
+    Dog::Id dog_id{0u};
+    std::optional<Direction> direction;
 };
 
 struct LootConfig {
@@ -224,27 +318,57 @@ struct LootConfig {
     double probability = 0.;
 };
 
+// лут сессии: плотный массив для обхода и swap-remove за O(1) по handle
+using LootStore = util::SlotMap<Loot>;
+
 class LootOfficeDogProvider : public collision_detector::ItemGathererProvider {
 public:
-    explicit LootOfficeDogProvider(const Map::Offices& offices);
+    // предметы - сначала все офисы карты, затем лут в плотном порядке хранилища.
+    // собиратели - это все собаки хранилища в порядке плотных индексов
+    LootOfficeDogProvider(const Map::Offices& offices, const LootStore* loot, const DogStore* dogs);
 
     size_t ItemsCount() const override;
     collision_detector::Item GetItem(size_t idx) const override;
     size_t GatherersCount() const override;
     collision_detector::Gatherer GetGatherer(size_t idx) const override;
 
-    void PushBackLoot(const Loot* loot);
-    void EraseLoot(size_t idx);
-    const std::variant<const Office*, const Loot*>& GetRawLootVal(size_t idx) const;
-    void AddGatherer(Dog* gatherer);
-    void EraseGatherer(Dog* gatherer);
-    const Dog* GetDog(size_t idx) const;
-    Dog* GetDog(size_t idx);
+    bool IsOffice(size_t idx) const noexcept;
+    const Loot& GetLoot(size_t idx) const;
+    // индексы предметов меняются после удаления лута, handle - нет
+    LootStore::Handle GetLootHandle(size_t idx) const;
 
+    // отметки "предмет уже подобран в этом тике", по биту на предмет
+    void ResetTaken();
+    bool IsTaken(size_t idx) const;
+    void MarkTaken(size_t idx);
 
 private:
-    std::vector<std::variant<const Office*, const Loot*>> items_;
-    std::vector<Dog*> gatherers_;
+    const Map::Offices* offices_;
+    const LootStore* loot_;
+    std::vector<bool> taken_;
+    const DogStore* dogs_;
+};
+
+// время фаз обновления сессии, суммируется по всем шагам одного Game::UpdateState
+struct SessionPhaseTimes {
+    std::chrono::nanoseconds movement{0};
+    std::chrono::nanoseconds loot_generation{0};
+    std::chrono::nanoseconds collisions{0};
+
+    std::chrono::nanoseconds Total() const noexcept {
+        return movement + loot_generation + collisions;
+    }
+};
+
+// что изменилось в сессии с заданной версии состояния
+struct StateDelta {
+    std::uint64_t version = 0;
+    // история не покрывает запрошенную версию, в дельте все состояние сессии
+    bool full = false;
+    std::vector<const Dog*> changed_dogs;
+    std::vector<Dog::Id> removed_dogs;
+    std::vector<const Loot*> added_loot;
+    std::vector<Loot::Id> removed_loot;
 };
 
 class GameSession {
@@ -253,10 +377,16 @@ public:
     using DogIdHasher = util::TaggedHasher<Dog::Id>;
     using IdToDogIndex = std::unordered_map<Dog::Id, std::shared_ptr<Dog>, DogIdHasher>;
 
-    using IdToLootIndex = std::map<Loot::Id, std::shared_ptr<Loot>>;
+    // сколько последних версий состояния помнит сессия для дельт
+    constexpr static size_t STATE_HISTORY_LENGTH = 128;
+    // сколько команд сессия принимает между двумя тиками
+    constexpr static size_t COMMAND_QUEUE_CAPACITY = 1024;
 
-    explicit GameSession(const Map* map, bool random_dog_spawn, const LootConfig& loot_config)
-        : map_(map)
+    using CommandQueue = util::MpscQueue<DogCommand>;
+
+    explicit GameSession(const Map* map, bool random_dog_spawn, const LootConfig& loot_config, Id id = Id{0u})
+        : id_(id)
+        , map_(map)
         , random_dog_spawn_(random_dog_spawn)
         , loot_generator_(loot_gen::LootGenerator::TimeInterval(static_cast<int>(loot_config.period * 1000)), // 1000 - is ms multiplier
                           loot_config.probability) {
@@ -270,40 +400,102 @@ public:
 
     GameSession(GameSession&&) = default;
 
+    const Id& GetId() const noexcept;
     const Map::Id& GetMapId() const;
     const model::Map* GetMap() const;
+    size_t GetDogsCount() const noexcept;
     Dog* AddDog(std::string_view name);
     void DeleteDog(const Dog::Id& id);
     const Dog* GetDog(Dog::Id id) const;
     Dog* GetDog(Dog::Id id);
     const IdToDogIndex& GetDogs() const;
-    const IdToLootIndex& GetAllLoot() const;
+    const DogStore& GetDogStore() const;
+    // лут в плотном порядке хранилища, не по id
+    const std::vector<Loot>& GetAllLoot() const;
 
-    void EraseLoot(Loot::Id loot_id);
+    /* Из любого потока, без strand: очередь потокобезопасна, поэтому команду можно отправить
+       и через const-указатель из опубликованного снимка. false - очередь заполнена
+     */
+    bool PostCommand(const DogCommand& command) const noexcept;
+    // применяет накопленные команды; собаки, которых уже нет, пропускаются
+    size_t ApplyCommands();
+
+    // меняется при любом изменении состояния сессии: тик, вход и выход игроков, действия собак
+    std::uint64_t GetRevision() const noexcept;
+    // номер версии состояния, растет на каждом шаге UpdateState
+    std::uint64_t GetStateVersion() const noexcept;
+    // история помнит все изменения после since
+    bool IsStateDeltaAvailable(std::uint64_t since) const noexcept;
+    // изменения после since; изменения между тиками относятся к следующей версии
+    StateDelta GetStateDelta(std::uint64_t since) const;
 
     void UpdateState(std::int64_t tick);
+    void ResetTickTimes() noexcept;
+    const SessionPhaseTimes& GetLastTickTimes() const noexcept;
+    std::chrono::nanoseconds GetLastTickDuration() const noexcept;
+
+    // без явного seed генератор инициализируется из std::random_device один раз при создании сессии
+    void SetRandomSeed(std::uint64_t seed);
 
     std::uint32_t GetNextDogId() const;
     std::uint32_t GetNextLootId() const;
 
-    void Restore(IdToDogIndex&& dogs, std::uint32_t next_dog_id, IdToLootIndex&& loot, std::uint32_t next_loot_id);
+    void Restore(IdToDogIndex&& dogs, std::uint32_t next_dog_id, std::vector<Loot>&& loot, std::uint32_t next_loot_id,
+                 std::uint64_t state_version = 0);
 
 private:
+    Id id_;
     const Map* map_;
+    std::shared_ptr<DogStore> dog_store_ = std::make_shared<DogStore>();
     IdToDogIndex dogs_;
     std::uint32_t next_dog_id_ = 0;
+    std::unique_ptr<CommandQueue> commands_ = std::make_unique<CommandQueue>(COMMAND_QUEUE_CAPACITY);
     bool random_dog_spawn_ = false;
 
-    IdToLootIndex loot_;
+    RandomEngine random_engine_{std::random_device{}()};
+    // провайдер столкновений читает лут по указателю, поэтому хранилище не переезжает вместе с сессией
+    std::unique_ptr<LootStore> loot_ = std::make_unique<LootStore>();
     std::uint32_t next_loot_id_ = 0;
     loot_gen::LootGenerator loot_generator_;
-    LootOfficeDogProvider items_gatherer_provider_{map_->GetOffices()};
+    LootOfficeDogProvider items_gatherer_provider_{map_->GetOffices(), loot_.get(), dog_store_.get()};
+    std::vector<LootStore::Handle> taken_loot_; // буфер тика
+    std::vector<geom::Point2D> next_positions_; // буфер тика, чтобы не выделять память заново
+    SessionPhaseTimes last_tick_times_;
+    std::uint64_t revision_ = 0;
+
+    // изменения, которые не видны по отметкам версий в DogStore: удаления и первый id нового лута
+    struct StateChanges {
+        std::uint64_t version = 0;
+        std::uint32_t first_loot_id = 0;
+        std::vector<Dog::Id> removed_dogs;
+        std::vector<Loot::Id> removed_loot;
+    };
+
+    std::uint64_t state_version_ = 0;
+    // последний элемент - изменения еще не завершенной версии state_version_ + 1
+    std::deque<StateChanges> state_history_{StateChanges{1, 0, {}, {}}};
+
+    void StartStateVersion();
 
     void UpdateDogsState(std::int64_t tick);
     void HandleCollisions();
     void GenerateLoot(std::int64_t tick);
 };
 
+// итог одного вызова Game::UpdateState
+struct TickReport {
+    std::chrono::milliseconds simulated{0};
+    std::chrono::milliseconds dropped{0};
+    std::chrono::milliseconds total_dropped{0}; // с момента запуска
+    unsigned steps = 0;
+};
+
+struct SessionTickTime {
+    Map::Id map_id;
+    GameSession::Id session_id;
+    SessionPhaseTimes phases;
+};
+
 class Game {
 public:
     using Maps = std::vector<Map>;
@@ -315,16 +507,23 @@ public:
     const Maps& GetMaps() const noexcept;
     const Map* FindMap(const Map::Id& id) const noexcept;
 
+    // всегда открывает новую сессию на карте
     GameSession& StartGameSession(const Map* map);
+    /* сессия для нового игрока: наименее загруженная из сессий карты, в которых еще есть
+       место. Если все сессии заполнены (или их нет), открывается новая
+     */
+    GameSession& GetSessionForNewPlayer(const Map* map);
+    // последняя открытая сессия на карте
     const GameSession* GetGameSession(Map::Id map_id) const;
     GameSession* GetGameSession(Map::Id map_id);
+    const GameSession* GetGameSession(Map::Id map_id, GameSession::Id session_id) const;
+    GameSession* GetGameSession(Map::Id map_id, GameSession::Id session_id);
     const SessionsByMaps& GetAllSessions() const;
     void RestoreSessions(SessionsByMaps&& restoring_sessions);
-    /* на данном этапе сессия будет одна, но можно будет расширить
-     функционал, если нужно будет ограничить количесто сессий на одной карте. Тогда вторым
-     аргументом в функцию будет передаваться, например, Id сессии.
-     На данном этапе мы создаем в векторе только одну сессию и берем ее с конца вектора
-     */
+
+    // 0 - без ограничения, все игроки карты попадают в одну сессию
+    void SetMaxPlayersPerSession(size_t max_players);
+    size_t GetMaxPlayersPerSession() const noexcept;
 
     void TurnOnRandomSpawn();
     void TurnOffRandomSpawn();
@@ -340,7 +539,31 @@ public:
 
     bool IsDogSpawnRandom() const;
 
-    void UpdateState(std::int64_t tick);
+    // сессия получает seed + id сессии, так что прогон с одним seed воспроизводим
+    void SetRandomSeed(std::uint64_t seed);
+    std::optional<std::uint64_t> GetRandomSeed() const noexcept;
+
+    /* при workers_count > 1 независимые сессии обновляются параллельно на пуле потоков.
+       UpdateState возвращается только после того, как обновились все сессии,
+       поэтому слушатели и запросы всегда видят согласованное состояние после тика
+     */
+    void SetTickWorkers(unsigned workers_count);
+    unsigned GetTickWorkers() const noexcept;
+
+    /* режим фиксированного шага: большой delta делится на шаги не длиннее max_step_ms,
+       а за один вызов моделируется не больше max_catch_up_ms, остаток отбрасывается.
+       0 отключает соответствующее ограничение
+     */
+    void SetFixedTimestep(std::int64_t max_step_ms, std::int64_t max_catch_up_ms);
+    // сколько времени из tick будет смоделировано
+    std::int64_t ClampTickDelta(std::int64_t tick) const noexcept;
+    // все отброшенное с момента запуска время
+    std::chrono::milliseconds GetDroppedTime() const noexcept;
+
+    // команды игроков применяются в начале тика, до движения
+    size_t ApplyCommands();
+    TickReport UpdateState(std::int64_t tick);
+    std::vector<SessionTickTime> GetSessionTickTimes() const;
 
 private:
 
@@ -352,8 +575,21 @@ private:
     bool random_dog_spawn_ = false;
 
     LootConfig loot_config_;
+    std::optional<std::uint64_t> random_seed_;
 
     SessionsByMaps sessions_;
+    size_t max_players_per_session_ = 0;
+    std::uint64_t next_session_id_ = 0;
+
+    std::int64_t max_tick_step_ = 0;
+    std::int64_t max_tick_catch_up_ = 0;
+    std::chrono::milliseconds dropped_time_{0};
+
+    unsigned tick_workers_ = 0;
+    std::unique_ptr<net::thread_pool> tick_pool_;
+
+    void UpdateSessions(std::int64_t tick);
+    void UpdateSessionsInParallel(std::int64_t tick);
 };
 
 }  // namespace model
@@ -21,23 +21,29 @@ namespace serialization {
 }
 
 GameSessionRepr::GameSessionRepr(const model::GameSession& session)
-    : map_id_(session.GetMap()->GetId())
+    : id_(session.GetId())
+    , map_id_(session.GetMap()->GetId())
     , next_dog_id_(session.GetNextDogId())
-    , next_loot_id_(session.GetNextLootId()) {
+    , next_loot_id_(session.GetNextLootId())
+    , state_version_(session.GetStateVersion()) {
     for (const auto& [_, dog] : session.GetDogs()) {
         dogs_.push_back(DogRepr(*dog));
     }
 
-    for (const auto& [_, loot_sptr] : session.GetAllLoot()) {
-        loot_.push_back(loot_sptr);
-    }
+    loot_ = session.GetAllLoot();
 }
 
 [[nodiscard]] std::shared_ptr<model::GameSession> GameSessionRepr::Restore(const model::Game* game) const {
+    return Restore(game, id_);
+}
+
+[[nodiscard]] std::shared_ptr<model::GameSession> GameSessionRepr::Restore(const model::Game* game,
+                                                                           model::GameSession::Id id) const {
     if (game->FindMap(map_id_) == nullptr) {
         throw std::logic_error("there is no map with such id");
     }
-    auto session = std::make_shared<model::GameSession>(game->FindMap(map_id_), game->IsDogSpawnRandom(), game->GetLootConfig());
+    auto session = std::make_shared<model::GameSession>(game->FindMap(map_id_), game->IsDogSpawnRandom(), game->GetLootConfig(),
+                                                         id);
 
     model::GameSession::IdToDogIndex dog_index;
     for (const DogRepr& dog_repr : dogs_) {
@@ -45,11 +51,11 @@ GameSessionRepr::GameSessionRepr(const model::GameSession& session)
         dog_index[dog->GetId()] = dog;
     }
 
-    model::GameSession::IdToLootIndex loot_index;
-    for (auto& loot : loot_) {
-        loot_index[loot->id] = loot;
+    if (auto seed = game->GetRandomSeed()) {
+        session->SetRandomSeed(*seed + *id);
     }
-    session->Restore(std::move(dog_index), next_dog_id_, std::move(loot_index), next_loot_id_);
+
+    session->Restore(std::move(dog_index), next_dog_id_, std::vector<model::Loot>(loot_), next_loot_id_, state_version_);
     return session;
 }
 
@@ -64,8 +70,10 @@ GameRepr::GameRepr(const model::Game& game) {
 void GameRepr::Restore(model::Game* game) const {
     try {
         model::Game::SessionsByMaps sessions;
+        std::uint64_t fresh_id = 0;
         for (auto& session_repr : sessions_) {
-            auto session_ptr = session_repr.Restore(game);
+            auto session_ptr = session_repr.HasId() ? session_repr.Restore(game)
+                                                    : session_repr.Restore(game, model::GameSession::Id{fresh_id++});
             sessions[session_ptr->GetMapId()].push_back(session_ptr);
         }
         game->RestoreSessions(std::move(sessions));
@@ -76,16 +84,18 @@ void GameRepr::Restore(model::Game* game) const {
 
 PlayersRepr::PlayersRepr(const user::Players& players) {
     for (const auto& player : players.GetAllPlayers()) {
-        players_.push_back({player->GetGameSession()->GetMapId(), player->GetDog()->GetId()});
+        const model::GameSession* session = player->GetGameSession();
+        players_.push_back({session->GetMapId(), session->GetId(), player->GetDog()->GetId()});
     }
 }
 
 user::Players PlayersRepr::Restore(model::Game* game) const {
     user::Players restored_players;
     for (const PlayerRepr& player : players_) {
-        auto* session = game->GetGameSession(player.map_id_);
+        auto* session = player.has_session_id_ ? game->GetGameSession(player.map_id_, player.session_id_)
+                                               : game->GetGameSession(player.map_id_);
         if (session == nullptr) {
-            session = &game->StartGameSession(game->FindMap(player.map_id_));
+            throw std::logic_error("there is no game session for restoring player");
         }
         restored_players.Add(session->GetDog(player.dog_id_),
                              session);
@@ -93,20 +103,42 @@ user::Players PlayersRepr::Restore(model::Game* game) const {
     return restored_players;
 }
 
+namespace {
+
+// в сохранениях версии 0 на карте одна сессия, и игрок определяется картой и собакой
+user::Player* FindPlayerOnMap(const user::Players& players, const model::Map::Id& map_id, model::Dog::Id dog_id) {
+    for (const auto& player : players.GetAllPlayers()) {
+        if (player->GetGameSession()->GetMapId() == map_id && player->GetDog()->GetId() == dog_id) {
+            return player.get();
+        }
+    }
+    return nullptr;
+}
+
+}  // namespace
+
 PlayerTokenRepr::PlayerTokenRepr(const user::PlayerTokens& player_tokens) {
-    for (const auto& [token, player_ptr] : player_tokens.token_to_player_) {
-        auto res = token_to_player_.emplace(*token, PlayerRepr{player_ptr->GetGameSession()->GetMapId(), player_ptr->GetDog()->GetId()});
+    player_tokens.token_to_player_.ForEach([this](const util::TokenKey& token, const user::Player* player_ptr) {
+        const model::GameSession* session = player_ptr->GetGameSession();
+        auto res = token_to_player_.emplace(token.ToString(), PlayerRepr{session->GetMapId(), session->GetId(),
+                                                                         player_ptr->GetDog()->GetId()});
         if (!res.second) {
             throw std::logic_error("trying to emplace duplicated token");
         }
-    }
+    });
 }
 
 user::PlayerTokens PlayerTokenRepr::Restore(user::Players* players) const {
     user::PlayerTokens restored_player_tokens;
     for (const auto& [token, player_repr] : token_to_player_) {
-        restored_player_tokens.token_to_player_.emplace(token, players->FindByDogIdAndMapId(player_repr.dog_id_,
-                                                                                            player_repr.map_id_));
+        auto key = util::TokenKey::Parse(token);
+        if (!key) {
+            throw std::logic_error("invalid player token in save");
+        }
+        user::Player* player = player_repr.has_session_id_
+            ? players->FindByDogIdAndSessionId(player_repr.dog_id_, player_repr.session_id_)
+            : FindPlayerOnMap(*players, player_repr.map_id_, player_repr.dog_id_);
+        restored_player_tokens.token_to_player_.Insert(*key, player);
     }
     return restored_player_tokens;
 }
@@ -117,7 +149,132 @@ void ApplicationRepr::Restore(app::Application* app) const {
     app->tokens_ = player_tokens_.Restore(&app->players_);
 }
 
-void SerializationListener::Serialize() const {
+namespace {
+
+std::chrono::microseconds ToMicroseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration);
+}
+
+}  // namespace
+
+SerializationListener::SerializationListener(std::chrono::milliseconds save_period, const app::Application* app,
+                                             std::filesystem::path state_file_path, bool background)
+    : save_period_(save_period)
+    , app_(app)
+    , state_file_path_(std::move(state_file_path)) {
+    if (background) {
+        writer_ = std::thread{[this] {
+            Run();
+        }};
+    }
+}
+
+SerializationListener::~SerializationListener() {
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void SerializationListener::SetReportHandler(ReportHandler handler) {
+    report_handler_ = std::move(handler);
+}
+
+void SerializationListener::Serialize() {
+    {
+        // фоновая запись идет в тот же временный файл
+        std::unique_lock lock{mutex_};
+        cv_.wait(lock, [this] {
+            return !writing_ && !pending_;
+        });
+    }
+
+    const auto start = Clock::now();
+    SaveReport report;
+    report.bytes = WriteFile(ApplicationRepr(*app_));
+    report.duration = ToMicroseconds(Clock::now() - start);
+    report.stall = report.duration;
+    Report(report);
+}
+
+void SerializationListener::OnTick(std::chrono::milliseconds delta) {
+    if (save_period_ == std::chrono::milliseconds::zero()) {
+        return;
+    }
+    time_since_save_ += delta;
+    if (time_since_save_ < save_period_) {
+        return;
+    }
+
+    if (!writer_.joinable()) {
+        Serialize();
+        time_since_save_ = std::chrono::milliseconds::zero();
+        return;
+    }
+
+    {
+        std::lock_guard lock{mutex_};
+        if (writing_ || pending_) {
+            return;
+        }
+    }
+    StartBackgroundSave();
+    time_since_save_ = std::chrono::milliseconds::zero();
+}
+
+void SerializationListener::StartBackgroundSave() {
+    // на strand игры - только копия состояния, сериализация и запись файла уходят в поток записи
+    const auto start = Clock::now();
+    auto snapshot = std::make_shared<const ApplicationRepr>(*app_);
+    SaveReport report;
+    report.background = true;
+    report.stall = ToMicroseconds(Clock::now() - start);
+
+    {
+        std::lock_guard lock{mutex_};
+        pending_ = std::move(snapshot);
+        pending_started_ = start;
+        pending_report_ = std::move(report);
+    }
+    cv_.notify_all();
+}
+
+void SerializationListener::Run() {
+    std::unique_lock lock{mutex_};
+    for (;;) {
+        cv_.wait(lock, [this] {
+            return stopping_ || pending_;
+        });
+        if (!pending_) {
+            return;
+        }
+
+        auto snapshot = std::move(pending_);
+        const auto started = pending_started_;
+        SaveReport report = std::move(pending_report_);
+        writing_ = true;
+        lock.unlock();
+
+        try {
+            report.bytes = WriteFile(*snapshot);
+        } catch (const std::exception& ex) {
+            report.error = ex.what();
+        }
+        snapshot.reset();
+        report.duration = ToMicroseconds(Clock::now() - started);
+        Report(report);
+
+        lock.lock();
+        writing_ = false;
+        cv_.notify_all();
+    }
+}
+
+std::uintmax_t SerializationListener::WriteFile(const ApplicationRepr& repr) const {
     std::filesystem::create_directories(state_file_path_.parent_path());
     std::filesystem::path tmp_path = state_file_path_.parent_path() / "tmp";
     std::ofstream strm{tmp_path, strm.binary | strm.trunc};
@@ -126,18 +283,19 @@ void SerializationListener::Serialize() const {
         throw std::logic_error("cannot open tmp save file and save game state");
     }
 
-    serialization::ApplicationRepr app_repr(*app_);
-    boost::archive::binary_oarchive o_archive{strm};
-    o_archive << app_repr;
+    {
+        boost::archive::binary_oarchive o_archive{strm};
+        o_archive << repr;
+    }
+    const auto bytes = static_cast<std::uintmax_t>(strm.tellp());
     strm.close();
     std::filesystem::rename(tmp_path, state_file_path_);
+    return bytes;
 }
 
-void SerializationListener::OnTick(std::chrono::milliseconds delta) {
-    time_since_save_ += delta;
-    if (time_since_save_ >= save_period_) {
-        Serialize();
-        save_period_ = std::chrono::milliseconds::zero();
+void SerializationListener::Report(const SaveReport& report) const {
+    if (report_handler_) {
+        report_handler_(report);
     }
 }
 
@@ -3,15 +3,23 @@
 #include <boost/serialization/shared_ptr.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/unordered_map.hpp>
+#include <boost/serialization/version.hpp>
 
 #include "app.h"
 #include "geom.h"
 #include "model.h"
 #include "player.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -111,22 +119,51 @@ public:
     explicit GameSessionRepr(const model::GameSession& session);
 
     [[nodiscard]] std::shared_ptr<model::GameSession> Restore(const model::Game* game) const;
+    // сохранения версии 0 не хранят id сессии, его выдает вызывающий
+    [[nodiscard]] std::shared_ptr<model::GameSession> Restore(const model::Game* game, model::GameSession::Id id) const;
 
+    bool HasId() const noexcept {
+        return has_id_;
+    }
+
+    // версия 0 - одна сессия на карту, без id и версии состояния, трофеи хранились через shared_ptr
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+    void serialize(Archive& ar, const unsigned version) {
+        if (version >= 1) {
+            ar& *id_;
+        } else {
+            has_id_ = false;
+        }
         ar& *map_id_;
         ar& dogs_;
         ar& next_dog_id_;
-        ar& loot_;
+        if (version >= 1) {
+            ar& loot_;
+        } else {
+            std::vector<std::shared_ptr<model::Loot>> legacy_loot;
+            ar& legacy_loot;
+            loot_.clear();
+            for (const auto& loot : legacy_loot) {
+                loot_.push_back(*loot);
+            }
+        }
         ar& next_loot_id_;
+        if (version >= 1) {
+            ar& state_version_;
+        } else {
+            state_version_ = 0;
+        }
     }
 
 private:
+    model::GameSession::Id id_ = model::GameSession::Id{0u};
+    bool has_id_ = true;
     model::Map::Id map_id_ = model::Map::Id{""};
     std::vector<DogRepr> dogs_;
     std::uint32_t next_dog_id_ = 0;
-    std::vector<std::shared_ptr<model::Loot>> loot_;
+    std::vector<model::Loot> loot_;
     std::uint32_t next_loot_id_ = 0;
+    std::uint64_t state_version_ = 0;
 };
 
 class GameRepr {
@@ -148,11 +185,19 @@ private:
 
 struct PlayerRepr {
     model::Map::Id map_id_ = model::Map::Id{""};
+    model::GameSession::Id session_id_ = model::GameSession::Id{0u};
     model::Dog::Id dog_id_ = model::Dog::Id{0u};
+    // в версии 0 игрок найдется по единственной сессии своей карты
+    bool has_session_id_ = true;
 
     template <typename Archive>
-    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+    void serialize(Archive& ar, const unsigned version) {
         ar& *map_id_;
+        if (version >= 1) {
+            ar& *session_id_;
+        } else {
+            has_session_id_ = false;
+        }
         ar& *dog_id_;
     }
 };
@@ -215,24 +260,72 @@ private:
     GameRepr game_repr_;
 };
 
+// итог одного сохранения
+struct SaveReport {
+    // сколько стоял strand игры: снимок, а при синхронной записи и сама запись
+    std::chrono::microseconds stall{0};
+    // от начала снимка до переименования файла
+    std::chrono::microseconds duration{0};
+    std::uintmax_t bytes = 0;
+    bool background = false;
+    // пусто - состояние сохранено
+    std::string error;
+};
+
+/* Периодическое сохранение состояния. В фоновом режиме тик платит только за снимок ApplicationRepr:
+   копия отдается потоку записи, который сериализует ее и пишет файл, пока игра идет дальше.
+   Если прошлая запись еще не закончилась, снимок откладывается до следующего тика
+ */
 class SerializationListener : public app::ApplicationListener {
 public:
-    explicit SerializationListener(std::chrono::milliseconds save_period, const app::Application* app,
-                                   std::filesystem::path state_file_path)
-    : save_period_(save_period)
-    , app_(app)
-    , state_file_path_(std::move(state_file_path)) {
-    }
+    using ReportHandler = std::function<void(const SaveReport&)>;
+
+    // save_period 0 - состояние сохраняется только вызовом Serialize
+    SerializationListener(std::chrono::milliseconds save_period, const app::Application* app,
+                          std::filesystem::path state_file_path, bool background = false);
+    ~SerializationListener();
+
+    SerializationListener(const SerializationListener&) = delete;
+    SerializationListener& operator=(const SerializationListener&) = delete;
+
+    // вызывается для каждого сохранения, в фоновом режиме - из потока записи; задается до первого тика
+    void SetReportHandler(ReportHandler handler);
 
-    void Serialize() const;
+    // синхронное сохранение; фоновая запись, если она идет, сначала дописывается
+    void Serialize();
     void OnTick(std::chrono::milliseconds delta) override;
+    std::string_view GetName() const override {
+        return "serialization";
+    }
 
 private:
+    using Clock = std::chrono::steady_clock;
+
     std::chrono::milliseconds save_period_;
     std::chrono::milliseconds time_since_save_{0};
 
     const app::Application* app_;
     std::filesystem::path state_file_path_;
+    ReportHandler report_handler_;
+
+    // снимок, который ждет потока записи, и время, когда его начали снимать
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::shared_ptr<const ApplicationRepr> pending_;
+    Clock::time_point pending_started_;
+    SaveReport pending_report_;
+    bool writing_ = false;
+    bool stopping_ = false;
+    std::thread writer_;
+
+    void StartBackgroundSave();
+    void Run();
+    // пишет во временный файл и переименовывает его; возвращает размер сохранения
+    std::uintmax_t WriteFile(const ApplicationRepr& repr) const;
+    void Report(const SaveReport& report) const;
 };
 
 }  // namespace serialization
+
+BOOST_CLASS_VERSION(::serialization::GameSessionRepr, 1)
+BOOST_CLASS_VERSION(::serialization::PlayerRepr, 1)
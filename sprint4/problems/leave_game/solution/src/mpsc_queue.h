@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+namespace util {
+
+/* Ограниченная очередь без блокировок: писать могут несколько потоков, читает один.
+   Каждая ячейка кольца хранит номер хода, по которому писатель и читатель понимают,
+   чья сейчас очередь (схема Д. Вьюкова). Память выделяется один раз в конструкторе,
+   поэтому TryPush не выделяет памяти и при заполненном кольце просто возвращает false
+ */
+template <typename T>
+class MpscQueue {
+public:
+    // capacity округляется вверх до степени двойки
+    explicit MpscQueue(std::size_t capacity)
+        : mask_(RoundUpToPowerOfTwo(capacity) - 1)
+        , cells_(std::make_unique<Cell[]>(mask_ + 1)) {
+        for (std::size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // из любого потока
+    bool TryPush(const T& value) noexcept {
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                // читатель еще не освободил ячейку: кольцо заполнено
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // только из потока-читателя
+    bool TryPop(T& value) noexcept {
+        Cell& cell = cells_[head_ & mask_];
+        if (cell.sequence.load(std::memory_order_acquire) != head_ + 1) {
+            // пусто или писатель занял ячейку, но еще не дописал
+            return false;
+        }
+        value = cell.value;
+        cell.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        return true;
+    }
+
+    std::size_t GetCapacity() const noexcept {
+        return mask_ + 1;
+    }
+
+private:
+    // писатели и читатель не должны делить одну строку кеша
+    constexpr static std::size_t CACHE_LINE = 64;
+
+    struct Cell {
+        std::atomic<std::size_t> sequence{0};
+        T value{};
+    };
+
+    static std::size_t RoundUpToPowerOfTwo(std::size_t capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("MpscQueue capacity must be positive");
+        }
+        std::size_t result = 1;
+        while (result < capacity) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const std::size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(CACHE_LINE) std::atomic<std::size_t> tail_{0};
+    alignas(CACHE_LINE) std::size_t head_ = 0;
+};
+
+}  // namespace util
@@ -1,6 +1,3 @@
-#include <iomanip>
-#include <sstream>
-
 #include "player.h"
 
 namespace user {
@@ -17,50 +14,45 @@ const model::GameSession* Player::GetGameSession() const {
     return session_;
 }
 
-Token PlayerTokens::GenerateUniqueToken() {
-    Token token{""};
+util::TokenKey PlayerTokens::GenerateUniqueToken() {
+    util::TokenKey key;
     do {
-        std::ostringstream ss;
-        ss << std::setw(16) << std::setfill('0') << std::hex << generator1_();
-        ss << std::setw(16) << std::setfill('f') << std::hex << generator2_();
-        *token = ss.str();
-    } while (token_to_player_.contains(token));
-    return token;
+        key = util::TokenKey{generator1_(), generator2_()};
+    } while (token_to_player_.Contains(key));
+    return key;
 }
 
 Token PlayerTokens::AddPlayer(Player* player) {
-    auto token = GenerateUniqueToken();
-    token_to_player_[token] = player;
-    return token;
+    const util::TokenKey key = GenerateUniqueToken();
+    token_to_player_.Insert(key, player);
+    return Token{key.ToString()};
 }
 
-void PlayerTokens::DeletePlayer(const Token& token) {
-    token_to_player_.erase(token);
+void PlayerTokens::DeletePlayer(std::string_view token) {
+    if (auto key = util::TokenKey::Parse(token)) {
+        token_to_player_.Erase(*key);
+    }
 }
 
-Player* PlayerTokens::FindPlayerByToken(const Token& token) {
-    if (token_to_player_.contains(token)) {
-        return token_to_player_.at(token);
-    }
-    return nullptr;
+Player* PlayerTokens::FindPlayerByToken(std::string_view token) {
+    Player** player = token_to_player_.Find(token);
+    return player ? *player : nullptr;
 }
 
-const Player* PlayerTokens::FindPlayerByToken(const Token& token) const {
-    if (token_to_player_.contains(token)) {
-        return token_to_player_.at(token);
-    }
-    return nullptr;
+const Player* PlayerTokens::FindPlayerByToken(std::string_view token) const {
+    Player* const* player = token_to_player_.Find(token);
+    return player ? *player : nullptr;
 }
 
 Player& Players::Add(model::Dog* dog, const model::GameSession* session) {
     players_.push_back(std::make_unique<Player>(session, dog));
     Player* player = players_.back().get();
-    map_to_dog_to_player_[session->GetMapId()][dog->GetId()] = player;
+    session_to_dog_to_player_[session->GetId()][dog->GetId()] = player;
     return *player;
 }
 
 void Players::Delete(Player* player) {
-    map_to_dog_to_player_.at(player->GetGameSession()->GetMap()->GetId())
+    session_to_dog_to_player_.at(player->GetGameSession()->GetId())
         .erase(player->GetDog()->GetId());
 
     players_.erase(std::find_if(players_.begin(), players_.end(), [&player] (auto val) {
@@ -68,9 +60,9 @@ void Players::Delete(Player* player) {
     }));
 }
 
-Player* Players::FindByDogIdAndMapId(model::Dog::Id dog_id, model::Map::Id map_id) {
-    if (map_to_dog_to_player_.contains(map_id) && map_to_dog_to_player_[map_id].contains(dog_id)) {
-        return map_to_dog_to_player_[map_id][dog_id];
+Player* Players::FindByDogIdAndSessionId(model::Dog::Id dog_id, model::GameSession::Id session_id) {
+    if (session_to_dog_to_player_.contains(session_id) && session_to_dog_to_player_[session_id].contains(dog_id)) {
+        return session_to_dog_to_player_[session_id][dog_id];
     }
     return nullptr;
 }
@@ -2,11 +2,13 @@
 
 #include <numeric>
 #include <random>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 #include "model.h"
 #include "tagged.h"
+#include "token_table.h"
 namespace serialization {
 class PlayerTokenRepr;
 } // namespace serialization
@@ -55,9 +57,20 @@ public:
     PlayerTokens& operator=(const PlayerTokens&) = delete;
 
     Token AddPlayer(Player* player);
-    void DeletePlayer(const Token& token);
-    Player* FindPlayerByToken(const Token& token);
-    const Player* FindPlayerByToken(const Token& token) const;
+    void DeletePlayer(std::string_view token);
+    // токен из запроса ищется как есть, без временной строки; nullptr, если игрока нет
+    Player* FindPlayerByToken(std::string_view token);
+    const Player* FindPlayerByToken(std::string_view token) const;
+
+    // fn(std::string_view token, const Player*); строка токена действительна только внутри вызова
+    template <typename Fn>
+    void ForEachPlayer(Fn&& fn) const {
+        token_to_player_.ForEach([&fn](const util::TokenKey& key, Player* player) {
+            char token[util::TokenKey::HEX_SIZE];
+            key.Format(token);
+            fn(std::string_view{token, sizeof(token)}, static_cast<const Player*>(player));
+        });
+    }
 
 private:
     std::random_device random_device_;
@@ -70,12 +83,11 @@ private:
         return dist(random_device_);
     }()};
 
-    using TokenHasher = util::TaggedHasher<Token>;
-    using TokenToPlayer = std::unordered_map<Token, Player*, TokenHasher>;
+    using TokenToPlayer = util::TokenTable<Player*>;
 
     TokenToPlayer token_to_player_;
 
-    Token GenerateUniqueToken();
+    util::TokenKey GenerateUniqueToken();
 };
 
 class Players {
@@ -84,16 +96,17 @@ public:
 
     Player& Add(model::Dog* dog, const model::GameSession* session);
     void Delete(Player* player);
-    Player* FindByDogIdAndMapId(model::Dog::Id dog_id, model::Map::Id map_id);
+    // id собак уникальны только в пределах сессии, поэтому игрок ищется по паре (сессия, собака)
+    Player* FindByDogIdAndSessionId(model::Dog::Id dog_id, model::GameSession::Id session_id);
     const PlayersList& GetAllPlayers() const;
 private:
-    using MapIdHasher = util::TaggedHasher<model::Map::Id>;
+    using SessionIdHasher = util::TaggedHasher<model::GameSession::Id>;
     using DogIdHasher = util::TaggedHasher<model::Dog::Id>;
-    using MapToDogToPlayerIndex = std::unordered_map<model::Map::Id, std::unordered_map<model::Dog::Id, Player*,
-                                    DogIdHasher>,
-                                    MapIdHasher>;
+    using SessionToDogToPlayerIndex = std::unordered_map<model::GameSession::Id, std::unordered_map<model::Dog::Id, Player*,
+                                        DogIdHasher>,
+                                        SessionIdHasher>;
 
     PlayersList players_;
-    MapToDogToPlayerIndex map_to_dog_to_player_;
+    SessionToDogToPlayerIndex session_to_dog_to_player_;
 };
 }
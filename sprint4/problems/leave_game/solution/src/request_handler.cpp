@@ -80,7 +80,7 @@ static std::string EncodeUriSpaces(std::string_view sub_uri) {
 }; // namespace http_handler::detail
 
 Uri::Uri(std::string_view uri, const fs::path& base)
-    : uri_(base / ((uri == "/"sv || uri == ""sv) ? "index.html"sv : EncodeUri(uri)))
+    : uri_(base / ((uri == "/"sv || uri == ""sv) ? "index.html"sv : DecodeUri(uri)))
     , canonical_uri_(fs::weakly_canonical(uri_)) {
 }
 
@@ -89,7 +89,11 @@ const fs::path& Uri::GetCanonicalUri() const {
 }
 
 Extention Uri::GetFileExtention() const {
-    auto extention = canonical_uri_.extension().string();
+    return http_handler::GetFileExtention(canonical_uri_);
+}
+
+Extention GetFileExtention(const fs::path& path) {
+    auto extention = path.extension().string();
     if (extention.empty()) {
         return Extention::empty;
     }
@@ -132,7 +136,7 @@ bool Uri::IsSubPath(const fs::path& base) const {
     return true;
 }
 
-std::string Uri::EncodeUri(std::string_view uri) const {
+std::string DecodeUri(std::string_view uri) {
     std::string encoded_uri;
     
     size_t pos = 1;
@@ -182,6 +186,91 @@ std::string ParseMapToJson(const model::Map* map) {
     return json::serialize(json::value_from(*map));
 }
 
+namespace {
+
+json::object RenderDog(const model::Dog& dog) {
+    const geom::Point2D& pos = dog.GetPosition();
+    const geom::Vec2D& speed = dog.GetSpeed();
+
+    json::array bag;
+    for (const auto& loot : dog.GetBag()->GetAllLoot()) {
+        bag.emplace_back(json::object{{"id", *loot.id}, {"type", loot.type}});
+    }
+
+    return {
+        {"pos", {pos.x, pos.y}},
+        {"speed", {speed.x, speed.y}},
+        {"dir", model::DirectionToString(dog.GetDirection())},
+        {"score", dog.GetScore()},
+        {"bag", std::move(bag)}
+    };
+}
+
+json::object RenderLoot(const model::Loot& loot) {
+    return {
+        {"type", loot.type},
+        {"pos", {loot.point.x, loot.point.y}}
+    };
+}
+
+template <typename Id>
+json::array RenderIds(const std::vector<Id>& ids) {
+    json::array result;
+    result.reserve(ids.size());
+    for (const auto& id : ids) {
+        result.push_back(std::to_string(*id));
+    }
+    return result;
+}
+
+} // namespace
+
+std::string RenderGameState(const model::GameSession& session) {
+    json::object players;
+    for (const auto& [id, dog] : session.GetDogs()) {
+        players.insert_or_assign(std::to_string(*id), RenderDog(*dog));
+    }
+
+    json::object lost_objects;
+    for (const model::Loot& loot : session.GetAllLoot()) {
+        lost_objects.insert_or_assign(std::to_string(*loot.id), RenderLoot(loot));
+    }
+
+    json::object game_state_json;
+    game_state_json["players"] = std::move(players);
+    game_state_json["lostObjects"] = std::move(lost_objects);
+    return json::serialize(json::value(std::move(game_state_json)));
+}
+
+std::string RenderPlayers(const model::GameSession& session) {
+    json::object players;
+    for (const auto& [id, dog] : session.GetDogs()) {
+        players[std::to_string(*id)] = {{"name", dog->GetName()}};
+    }
+    return json::serialize(json::value(std::move(players)));
+}
+
+std::string RenderStateDelta(const model::StateDelta& delta) {
+    json::object players;
+    for (const model::Dog* dog : delta.changed_dogs) {
+        players.insert_or_assign(std::to_string(*dog->GetId()), RenderDog(*dog));
+    }
+
+    json::object lost_objects;
+    for (const model::Loot* loot : delta.added_loot) {
+        lost_objects.insert_or_assign(std::to_string(*loot->id), RenderLoot(*loot));
+    }
+
+    json::object delta_json;
+    delta_json["version"] = delta.version;
+    delta_json["full"] = delta.full;
+    delta_json["players"] = std::move(players);
+    delta_json["removedPlayers"] = RenderIds(delta.removed_dogs);
+    delta_json["lostObjects"] = std::move(lost_objects);
+    delta_json["removedObjects"] = RenderIds(delta.removed_loot);
+    return json::serialize(json::value(std::move(delta_json)));
+}
+
 std::unordered_map<std::string, std::string> ParseQuery(std::string_view query) {
     std::unordered_map<std::string, std::string> query_map;
 
@@ -200,45 +289,184 @@ std::unordered_map<std::string, std::string> ParseQuery(std::string_view query)
     return query_map;
 }
 
-void ApiRequestHandler::ProcessApiMaps(StringResponse& response,
-                                       std::string_view target) const {
-    size_t target_legth = 12;
-    if (target.size() > target_legth && target[target_legth] != '/') {
-        MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::bad_request, "Bad request");
-        return;
+namespace {
+
+std::int64_t ToMicroseconds(std::chrono::nanoseconds duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+json::value MakeSlowTickData(const app::TickPhases& phases, const model::TickReport& report,
+                             std::chrono::milliseconds budget) {
+    json::array listeners;
+    for (const auto& [name, duration] : phases.listeners) {
+        listeners.push_back({{"name", name}, {"time_us", ToMicroseconds(duration)}});
+    }
+    json::array processed_listeners;
+    for (const auto& [name, duration] : phases.processed_listeners) {
+        processed_listeners.push_back({{"name", name}, {"time_us", ToMicroseconds(duration)}});
     }
 
-    if (target.size() > target_legth +1) {
-        std::string map_name(target.begin() + target_legth + 1,
-            *(target.end() - 1) == '/' ? target.end() - 1 : target.end());
+    json::array sessions;
+    for (const auto& [map_id, session_id, session_phases] : phases.sessions) {
+        sessions.push_back({
+            {"map", *map_id},
+            {"session", *session_id},
+            {"time_us", ToMicroseconds(session_phases.Total())},
+            {"movement_us", ToMicroseconds(session_phases.movement)},
+            {"loot_generation_us", ToMicroseconds(session_phases.loot_generation)},
+            {"collisions_us", ToMicroseconds(session_phases.collisions)}
+        });
+    }
 
-        try {
-            const model::Map* map = app_.FindMap(model::Map::Id(map_name));
-            response.body() = ParseMapToJson(map);
-        } catch (const app::GetMapError& error) {
-            switch (error.reason) {
-                case app::GetMapErrorReason::mapNotFound:
-                    MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::map_not_found, error.what());
-                    return;
-            }
-        }
+    return {
+        {"budget_ms", budget.count()},
+        {"tick_time_us", ToMicroseconds(phases.total)},
+        {"simulated_ms", report.simulated.count()},
+        {"steps", report.steps},
+        {"listeners", std::move(listeners)},
+        {"update_state_us", ToMicroseconds(phases.update_state)},
+        {"after_tick_listeners", std::move(processed_listeners)},
+        {"sessions", std::move(sessions)}
+    };
+}
+
+} // namespace
+
+void LogTickReport(const app::Application& app, const model::TickReport& report) {
+    if (report.dropped.count() > 0) {
+        http_logger::LogDroppedTickTime(report.dropped.count(), report.simulated.count(),
+                                        report.total_dropped.count());
+    }
+    if (app.IsLastTickOverBudget()) {
+        http_logger::LogSlowTick(MakeSlowTickData(app.GetLastTickPhases(), report, app.GetTickBudget()));
+    }
+}
+
+void ApiRequestHandler::BuildMapResponses() {
+    json::array maps_json;
+    for (const auto& map : app_.ListMaps()) {
+        maps_json.push_back({
+            {"id", *map.GetId()}, {"name", map.GetName()}
+                            });
+        map_responses_.emplace(map.GetId(), MakeCachedResponse(ParseMapToJson(&map)));
+    }
+    map_list_response_ = MakeCachedResponse(json::serialize(json::value(std::move(maps_json))));
+}
+
+const CachedResponse* ApiRequestHandler::FindMapResponse(StringResponse& response,
+                                                         std::string_view map_id) const {
+    if (auto it = map_responses_.find(model::Map::Id(std::string(map_id))); it != map_responses_.end()) {
+        return &it->second;
+    }
+    MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::map_not_found,
+                         app::GetMapError{app::GetMapErrorReason::mapNotFound}.what());
+    return nullptr;
+}
+
+StateSnapshotCache::StateSnapshot& StateSnapshotCache::Refresh(const model::GameSession* session) {
+    const std::uint64_t revision = session->GetRevision();
+    auto [it, inserted] = snapshots_.try_emplace(session);
+    auto& snapshot = it->second;
+    if (inserted || snapshot.revision != revision) {
+        // состояние меняется каждый тик, поэтому gzip-вариант для него не готовится
+        snapshot.response = MakeCachedResponse(RenderGameState(*session), false);
+        snapshot.revision = revision;
+        snapshot.deltas.clear();
+    }
+    return snapshot;
+}
+
+const CachedResponse& StateSnapshotCache::GetSnapshot(const model::GameSession* session) {
+    return Refresh(session).response;
+}
+
+const CachedResponse& StateSnapshotCache::GetDelta(const model::GameSession* session, std::uint64_t since) {
+    auto& snapshot = Refresh(session);
+    // все неподходящие since получают один и тот же полный ответ
+    const std::uint64_t key = session->IsStateDeltaAvailable(since) ? since : FULL_STATE_DELTA;
+    auto [it, inserted] = snapshot.deltas.try_emplace(key);
+    if (inserted) {
+        it->second = MakeCachedResponse(RenderStateDelta(session->GetStateDelta(since)), false);
+    }
+    return it->second;
+}
+
+std::optional<std::uint64_t> ApiRequestHandler::ParseStateVersion(std::string_view str) {
+    std::uint64_t version = 0;
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), version);
+    if (ec != std::errc{} || end != str.data() + str.size() || str.empty()) {
+        return std::nullopt;
+    }
+    return version;
+}
+
+ApiRequestHandler::MoveTarget ApiRequestHandler::FindMoveTarget(std::string_view token,
+                                                                const PublishedState& published) {
+    MoveTarget target;
+    if (manual_update_) {
+        // запрос уже на strand игры
+        target.player = app_.FindPlayer(token);
     } else {
-        json::array maps_json;
-        const model::Game::Maps& maps = app_.ListMaps();
-        for (const auto& map : maps) {
-            maps_json.push_back({
-                {"id", *map.GetId()}, {"name", map.GetName()}
-                                });
-        }
-        response.body() = json::serialize(json::value(std::move(maps_json)));
+        target.published = published.FindPlayer(token);
     }
+    return target;
+}
 
-    response.set(http::field::content_type, ContentType::APP_JSON);
-    response.content_length(response.body().size());
-    response.result(http::status::ok);
+ApiRequestHandler::MoveResult ApiRequestHandler::SubmitMove(const MoveTarget& target, const json::value& move) {
+    const json::string* move_str = move.if_string();
+    if (!target) {
+        return MoveResult::unknown_token;
+    }
+    if (move_str == nullptr) {
+        return MoveResult::invalid_move;
+    }
+
+    if (target.player) {
+        return app_.MoveDog(*target.player, *move_str) ? MoveResult::ok : MoveResult::invalid_move;
+    }
+
+    auto command = app::ParseDogCommand(target.published->dog_id, *move_str);
+    if (!command) {
+        return MoveResult::invalid_move;
+    }
+    return target.published->session->PostCommand(*command) ? MoveResult::ok : MoveResult::queue_full;
 }
 
+ApiRequestHandler::MoveResult ApiRequestHandler::SubmitMove(std::string_view token, const json::value& move) {
+    auto published = publisher_.Load();
+    return SubmitMove(FindMoveTarget(token, *published), move);
+}
 
+std::string ApiRequestHandler::RenderMoveResults(const json::array& actions, const PublishedState& published) {
+    json::array results;
+    results.reserve(actions.size());
+    for (const json::value& action : actions) {
+        const json::object* fields = action.if_object();
+        const json::value* token = fields ? fields->if_contains("token") : nullptr;
+        const json::value* move = fields ? fields->if_contains("move") : nullptr;
+
+        MoveResult result = MoveResult::invalid_move;
+        if (token && move && token->is_string()) {
+            result = SubmitMove(FindMoveTarget(token->as_string(), published), *move);
+        }
+
+        switch (result) {
+            case MoveResult::ok:
+                results.emplace_back(json::object{});
+                break;
+            case MoveResult::unknown_token:
+                results.emplace_back(json::object{{"code", "unknownToken"}, {"message", "Player token has not been found"}});
+                break;
+            case MoveResult::invalid_move:
+                results.emplace_back(json::object{{"code", "invalidArgument"}, {"message", "Failed to parse action"}});
+                break;
+            case MoveResult::queue_full:
+                results.emplace_back(json::object{{"code", "serviceUnavailable"}, {"message", "Too many actions"}});
+                break;
+        }
+    }
+    return json::serialize(results);
+}
 
 void ApiRequestHandler::MakeErrorApiResponse(StringResponse& response, ApiRequestHandler::ErrorCode code,
                                              std::string_view message) const {
@@ -325,31 +553,83 @@ void ApiRequestHandler::MakeErrorApiResponse(StringResponse& response, ApiReques
             response.body() = json::serialize(jv);
             break;
         }
+
+        case ec::service_unavailable:
+        {
+            response.result(http::status::service_unavailable);
+            json::value jv = {
+                {"code", "serviceUnavailable"},
+                {"message", message}
+            };
+            response.body() = json::serialize(jv);
+            response.set(http::field::retry_after, "1");
+            break;
+        }
     }
     response.content_length(response.body().size());
 }
 
-http::status StaticRequestHandler::ProcessStaticFileTarget(FileResponse& response,
-                                                     std::string_view target) const {
-    Uri uri(target, static_files_path_);
-    if (!uri.IsSubPath(static_files_path_)) {
-        return http::status::bad_request;
+void ApiRequestHandler::MakeMethodErrorApiResponse(StringResponse& response, ApiEndpoint endpoint) const {
+    using namespace std::literals;
+
+    switch (endpoint) {
+        case ApiEndpoint::join:
+            MakeErrorApiResponse(response, ErrorCode::invalid_method_post, "Only POST method is expected"sv);
+            break;
+        case ApiEndpoint::action:
+        case ApiEndpoint::actions:
+        case ApiEndpoint::tick:
+            MakeErrorApiResponse(response, ErrorCode::invalid_method_post, "Invalid method"sv);
+            break;
+        default:
+            MakeErrorApiResponse(response, ErrorCode::invalid_method_get_head, "Invalid method"sv);
+            break;
     }
+}
 
-    http::file_body::value_type file;
+namespace {
 
-    if (http_server::sys::error_code ec; file.open(uri.GetCanonicalUri().string().data(), beast::file_mode::read, ec), ec) {
+// файл открывается и для HEAD: так ответ сообщает об ошибке открытия так же, как GET
+http::status OpenFileBody(FileResponse& response, const fs::path& path, bool head) {
+    auto file = std::make_shared<beast::file>();
+    beast::error_code ec;
+    file->open(path.string().data(), beast::file_mode::scan, ec);
+    if (ec) {
+        return http::status::not_found;
+    }
+    const std::uint64_t size = file->size(ec);
+    if (ec) {
         return http::status::not_found;
     }
 
-    response.set(http::field::content_type, GetMimeType(uri.GetFileExtention()));
-    response.body() = std::move(file);
-    response.prepare_payload();
+    response.body().size = size;
+    if (!head) {
+        response.body().file = std::move(file);
+    }
+    response.content_length(size);
     response.result(http::status::ok);
-
     return http::status::ok;
 }
 
+} // namespace
+
+http::status StaticRequestHandler::OpenCachedFile(FileResponse& response, const StaticFileCache::Entry& entry,
+                                                  bool head) const {
+    response.base() = entry.header;
+    return OpenFileBody(response, entry.path, head);
+}
+
+http::status StaticRequestHandler::ProcessStaticFileTarget(FileResponse& response,
+                                                           std::string_view target, bool head) const {
+    Uri uri(target, static_files_path_);
+    if (!uri.IsSubPath(static_files_path_)) {
+        return http::status::bad_request;
+    }
+
+    response.set(http::field::content_type, GetMimeType(uri.GetFileExtention()));
+    return OpenFileBody(response, uri.GetCanonicalUri(), head);
+}
+
 StringResponse StaticRequestHandler::MakeErrorStaticFileResponse(http::status status) const {
     StringResponse response;
     response.result(status);
@@ -378,4 +658,74 @@ StringResponse StaticRequestHandler::MakeErrorStaticFileResponse(http::status st
     return response;
 }
 
+namespace {
+
+constexpr std::string_view GAME_SOCKET_TARGET = "/api/v1/game/ws";
+constexpr size_t TOKEN_SIZE = 32;
+
+StringResponse MakeUpgradeError(http::status status, std::string_view code, std::string_view message) {
+    StringResponse response{status, 11};
+    response.set(http::field::content_type, ContentType::APP_JSON);
+    response.set(http::field::cache_control, "no-cache");
+    json::value jv = {
+        {"code", code},
+        {"message", message}
+    };
+    response.body() = json::serialize(jv);
+    return response;
+}
+
+// браузер не умеет ставить заголовки на WebSocket, поэтому токен можно передать и в ?token=
+std::string GetSocketToken(const http_server::StringRequest& req) {
+    using namespace std::literals;
+
+    if (auto auth = req.find(http::field::authorization); auth != req.end()) {
+        std::string_view value = auth->value();
+        if (value.substr(0, 7) == "Bearer "sv) {
+            return std::string(value.substr(7));
+        }
+        return {};
+    }
+
+    std::string_view target = req.target();
+    if (size_t query_pos = target.find('?'); query_pos != std::string_view::npos) {
+        auto query = ParseQuery(target.substr(query_pos + 1));
+        if (auto token = query.find("token"); token != query.end()) {
+            return token->second;
+        }
+    }
+    return {};
+}
+
+} // namespace
+
+void RequestHandler::Upgrade(http_server::StringRequest&& req, beast::tcp_stream&& stream) {
+    using namespace std::literals;
+
+    std::string_view target = req.target();
+    if (target.substr(0, target.find('?')) != GAME_SOCKET_TARGET) {
+        auto socket = std::make_shared<StateSocket>(std::move(stream), *api_handler_, api_strand_, std::string{});
+        socket->Reject(MakeUpgradeError(http::status::bad_request, "badRequest"sv,
+                                        "WebSocket is available only at /api/v1/game/ws"sv));
+        return;
+    }
+
+    auto socket = std::make_shared<StateSocket>(std::move(stream), *api_handler_, api_strand_, GetSocketToken(req));
+    // токен проверяется на strand игры: там же игроки добавляются и удаляются
+    net::dispatch(api_strand_, [self = shared_from_this(), socket, req = std::move(req)]() mutable {
+        if (socket->GetToken().size() != TOKEN_SIZE) {
+            socket->Reject(MakeUpgradeError(http::status::unauthorized, "invalidToken"sv,
+                                            "Authorization header or token parameter is required"sv));
+            return;
+        }
+        if (self->app_.FindPlayer(socket->GetToken()) == nullptr) {
+            socket->Reject(MakeUpgradeError(http::status::unauthorized, "unknownToken"sv,
+                                            "Player token has not been found"sv));
+            return;
+        }
+        self->state_broadcaster_->Add(socket);
+        socket->Accept(std::move(req));
+    });
+}
+
 }  // namespace http_handler
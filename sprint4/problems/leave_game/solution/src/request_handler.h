@@ -4,16 +4,24 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/strand.hpp>
 
+#include "api_router.h"
 #include "app.h"
 #include "http_server.h"
 #include "logger.h"
 #include "model.h"
 #include "player.h"
+#include "response_cache.h"
+#include "state_publisher.h"
+#include "state_socket.h"
+#include "static_cache.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <charconv>
 #include <filesystem>
 #include <iomanip>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <string_view>
@@ -29,6 +37,9 @@ namespace json = boost::json;
 
 using Strand = net::strand<net::io_context::executor_type>;
 
+// пишет в лог отброшенное время и разбивку тика по фазам, если тик не уложился в бюджет
+void LogTickReport(const app::Application& app, const model::TickReport& report);
+
 enum class Extention {
     empty, unkown,
     htm, html, css, txt, js, json, xml,
@@ -49,10 +60,12 @@ public:
 private:
     fs::path uri_;
     fs::path canonical_uri_;
-
-    std::string EncodeUri(std::string_view uri) const;
 };
 
+// путь запроса без ведущего '/' с раскрытыми %XX и '+'
+std::string DecodeUri(std::string_view uri);
+Extention GetFileExtention(const fs::path& path);
+
 struct ContentType {
     ContentType() = delete;
     constexpr static std::string_view APP_JSON = "application/json";
@@ -81,19 +94,76 @@ void FillBasicInfo(Request& req, Response& response) {
     response.keep_alive(req.keep_alive());
 }
 
+// заголовки ответа берутся из пула соединения, как и заголовки запроса
+template <typename Response, typename Request>
+Response MakeResponse(Request& req) {
+    Response response{typename Response::header_type{req.get_allocator()}};
+    FillBasicInfo(req, response);
+    return response;
+}
+
 std::string_view GetMimeType(Extention extention);
 std::string ParseMapToJson(const model::Map* map);
+std::string RenderGameState(const model::GameSession& session);
+std::string RenderPlayers(const model::GameSession& session);
+std::string RenderStateDelta(const model::StateDelta& delta);
 std::unordered_map<std::string, std::string> ParseQuery(std::string_view query);
 
-using StringResponse = http::response<http::string_body>;
-using FileResponse = http::response<http::file_body>;
+using StringResponse = http::response<http::string_body, http_server::ArenaFields>;
+using FileResponse = http_server::SendfileResponse;
+
+enum class ApiEndpoint {
+    list_maps, get_map, players, join, state, action, actions, tick, records
+};
+
+inline constexpr MethodMask GET_HEAD_METHODS{http::verb::get, http::verb::head};
+inline constexpr MethodMask POST_METHODS{http::verb::post};
+
+inline constexpr RouteTable API_ROUTES{std::array{
+    Route<ApiEndpoint>{"/api/v1/maps", ApiEndpoint::list_maps, GET_HEAD_METHODS},
+    Route<ApiEndpoint>{"/api/v1/maps/{id}", ApiEndpoint::get_map, GET_HEAD_METHODS},
+    Route<ApiEndpoint>{"/api/v1/game/players", ApiEndpoint::players, GET_HEAD_METHODS},
+    Route<ApiEndpoint>{"/api/v1/game/join", ApiEndpoint::join, POST_METHODS},
+    Route<ApiEndpoint>{"/api/v1/game/state", ApiEndpoint::state, GET_HEAD_METHODS},
+    Route<ApiEndpoint>{"/api/v1/game/player/action", ApiEndpoint::action, POST_METHODS},
+    Route<ApiEndpoint>{"/api/v1/game/player/actions", ApiEndpoint::actions, POST_METHODS},
+    Route<ApiEndpoint>{"/api/v1/game/tick", ApiEndpoint::tick, POST_METHODS},
+    Route<ApiEndpoint>{"/api/v1/game/records", ApiEndpoint::records, GET_HEAD_METHODS},
+}};
+
+/* Состояние сессии рисуется один раз на ревизию и раздается всем игрокам сессии:
+   и HTTP-запросам, и WebSocket-подписчикам. Сессии живут до конца работы сервера,
+   поэтому ключом служит указатель. Кеш используется только на strand игры
+ */
+class StateSnapshotCache {
+public:
+    const CachedResponse& GetSnapshot(const model::GameSession* session);
+    const CachedResponse& GetDelta(const model::GameSession* session, std::uint64_t since);
+
+private:
+    struct StateSnapshot {
+        std::uint64_t revision = 0;
+        CachedResponse response;
+        // дельты той же ревизии по значению since, полные ответы лежат под FULL_STATE_DELTA
+        std::unordered_map<std::uint64_t, CachedResponse> deltas;
+    };
+    constexpr static std::uint64_t FULL_STATE_DELTA = std::numeric_limits<std::uint64_t>::max();
+
+    std::unordered_map<const model::GameSession*, StateSnapshot> snapshots_;
+
+    StateSnapshot& Refresh(const model::GameSession* session);
+};
 
 class ApiRequestHandler : public std::enable_shared_from_this<ApiRequestHandler> {
 public:
 
-    explicit ApiRequestHandler(app::Application& app, bool manual_update)
+    explicit ApiRequestHandler(app::Application& app, StateSnapshotCache& state_cache,
+                               const StatePublisher& publisher, bool manual_update)
         : app_(app)
+        , state_cache_(state_cache)
+        , publisher_(publisher)
         , manual_update_(manual_update) {
+        BuildMapResponses();
     }
 
     ApiRequestHandler(const ApiRequestHandler&) = delete;
@@ -104,76 +174,129 @@ public:
         SendApiResponse(std::forward<Request>(req), std::forward<Send>(send), req.target());
     }
 
+    /* Запросы, которые не трогают модель: карты, рекорды, список игроков и полное состояние.
+       Их можно обслуживать в любом потоке, остальные выполняются на strand игры
+     */
+    template <typename Request>
+    static bool IsReadOnly(const Request& req) {
+        using namespace std::literals;
+
+        std::string_view target = req.target();
+        const auto route = API_ROUTES.Find(target);
+        if (!route) {
+            return false;
+        }
+        switch (route.route->endpoint) {
+            case ApiEndpoint::list_maps:
+            case ApiEndpoint::get_map:
+            case ApiEndpoint::players:
+            case ApiEndpoint::records:
+                return true;
+            case ApiEndpoint::state: {
+                // дельтам нужна история сессии, она есть только на strand
+                size_t query_pos = target.find('?');
+                return query_pos == std::string_view::npos
+                    || !ParseQuery(target.substr(query_pos + 1)).contains("since"s);
+            }
+            default:
+                return false;
+        }
+    }
+
+    /* Команды игроков. Когда время идет само, они не ждут strand: игрок ищется в опубликованном
+       снимке, команда уходит в очередь его сессии и применяется в начале ближайшего тика.
+       В режиме ручного тика команды выполняются на strand и видны сразу
+     */
+    template <typename Request>
+    bool IsQueuedAction(const Request& req) const {
+        if (manual_update_) {
+            return false;
+        }
+        const auto route = API_ROUTES.Find(req.target());
+        return route && (route.route->endpoint == ApiEndpoint::action || route.route->endpoint == ApiEndpoint::actions);
+    }
+
+    enum class MoveResult {
+        ok, unknown_token, invalid_move, queue_full
+    };
+
+    bool IsManualUpdate() const noexcept {
+        return manual_update_;
+    }
+
+    /* Команда из WebSocket идет тем же путем, что и POST /api/v1/game/player/action.
+       В режиме ручного тика вызывается на strand игры, иначе - из любого потока
+     */
+    MoveResult SubmitMove(std::string_view token, const json::value& move);
+
 private:
+    using MapIdToResponse = std::unordered_map<model::Map::Id, CachedResponse, model::Game::MapIdHasher>;
+
     app::Application& app_;
+    StateSnapshotCache& state_cache_;
+    const StatePublisher& publisher_;
     bool manual_update_;
 
+    // карты не меняются после загрузки, поэтому их ответы сериализуются один раз
+    CachedResponse map_list_response_;
+    MapIdToResponse map_responses_;
+
     template <typename Request, typename Send>
     void SendApiResponse(Request&& req, Send&& send, std::string_view target) {
         using namespace std::literals;
 
-        StringResponse response;
-        FillBasicInfo(req, response);
+        auto response = MakeResponse<StringResponse>(req);
         response.set(http::field::cache_control, "no-cache");
         try {
-
-            if (target.substr(0, 12) == "/api/v1/maps"sv) {
-                switch (req.method()) {
-                    case http::verb::get:
-                    case http::verb::head:
-                        ProcessApiMaps(response, target);
-                        break;
-                    default:
-                        MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::invalid_method_get_head,
-                                             "Invalid method"sv);
-                        break;
-                }
-            } else if (target.substr(0, 20) == "/api/v1/game/players"sv) {
-                switch (req.method()) {
-                    case http::verb::get:
-                    case http::verb::head:
-                        ProcessApiPlayers(req, response);
+            const auto route = API_ROUTES.Find(target);
+            if (!route) {
+                MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::bad_request,
+                                     "Bad request"sv);
+            } else if (!route.route->methods.Contains(req.method())) {
+                MakeMethodErrorApiResponse(response, route.route->endpoint);
+            } else {
+                switch (route.route->endpoint) {
+                    case ApiEndpoint::list_maps:
+                        SendCachedResponse(req, std::forward<Send>(send), map_list_response_);
+                        return;
+
+                    case ApiEndpoint::get_map:
+                        if (const CachedResponse* map = FindMapResponse(response, route.params[0])) {
+                            SendCachedResponse(req, std::forward<Send>(send), *map);
+                            return;
+                        }
                         break;
-                    default:
-                        MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::invalid_method_get_head,
-                                             "Invalid method"sv);
+
+                    case ApiEndpoint::players:
+                        if (auto published = publisher_.Load(); const CachedResponse* players
+                                = ProcessApiPlayers(req, response, *published)) {
+                            SendCachedResponse(req, std::forward<Send>(send), *players);
+                            return;
+                        }
                         break;
-                }
-            } else if (target.substr(0, 17) == "/api/v1/game/join"sv) {
-                switch (req.method()) {
-                    case http::verb::post:
+
+                    case ApiEndpoint::join:
                         ProcessApiJoin(req, response);
                         break;
-                    default:
-                        MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::invalid_method_post,
-                                             "Only POST method is expected"sv);
-                        break;
-                }
-            } else if (target.substr(0, 18) == "/api/v1/game/state"sv) {
-                switch (req.method()) {
-                    case http::verb::get:
-                    case http::verb::head:
-                        ProcessApiGameState(req, response);
-                        break;
-                    default:
-                        MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::invalid_method_get_head,
-                                             "Invalid method"sv);
+
+                    case ApiEndpoint::state:
+                        // снимок держится до конца отправки: ответ может ссылаться на его данные
+                        if (auto published = publisher_.Load(); const CachedResponse* state
+                                = ProcessApiGameState(req, response, *published)) {
+                            SendCachedResponse(req, std::forward<Send>(send), *state);
+                            return;
+                        }
                         break;
-                }
-            } else if (target.substr(0, 26) == "/api/v1/game/player/action"sv) {
-                switch (req.method()) {
-                    case http::verb::post:
+
+                    case ApiEndpoint::action:
                         ProcessApiAction(req, response);
                         break;
 
-                    default:
-                        MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::invalid_method_post,
-                                             "Invalid method"sv);
+                    case ApiEndpoint::actions:
+                        ProcessApiActions(req, response);
                         break;
-                }
-            } else if (target.substr(0, 17) == "/api/v1/game/tick"sv) {
-                switch (req.method()) {
-                    case http::verb::post:
+
+                    case ApiEndpoint::tick:
                         if (manual_update_) {
                             ProcessApiTick(req, response);
                         } else {
@@ -182,24 +305,10 @@ private:
                         }
                         break;
 
-                    default:
-                        MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::invalid_method_post,
-                                             "Invalid method"sv);
-                        break;
-                }
-            } else if (target.substr(0, 20) == "/api/v1/game/records"sv) {
-                switch (req.method()) {
-                    case http::verb::get:
-                    case http::verb::head:
+                    case ApiEndpoint::records:
                         ProcessGetRecords(req, response);
                         break;
-                    default:
-                        MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::invalid_method_get_head,
-                                             "Invalid method"sv);
                 }
-            } else {
-                MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::bad_request,
-                                     "Bad request"sv);
             }
         } catch (...) {
             MakeErrorApiResponse(response, ApiRequestHandler::ErrorCode::bad_request,
@@ -210,24 +319,45 @@ private:
         send(response);
     }
 
-    void ProcessApiMaps(StringResponse& response, std::string_view target) const;
+    void BuildMapResponses();
+    // nullptr, если карта не найдена: тогда в response уже записана ошибка
+    const CachedResponse* FindMapResponse(StringResponse& response, std::string_view map_id) const;
 
-    template <typename Request>
-    void ProcessApiPlayers(Request& request, StringResponse& response) const {
-
-        ExecuteAuthorized(request, response, [self = shared_from_this(), &response](std::string_view token) {
-            const auto& players = self->app_.ListPlayers(token);
-            json::object players_on_map_json;
-            for (const auto& [id, player] : players) {
-                players_on_map_json[std::to_string(*id)] = {{"name", player->GetName()}};
-            }
+    template <typename Request, typename Send>
+    void SendCachedResponse(const Request& req, Send&& send, const CachedResponse& cached) const {
+        const bool use_gzip = cached.gzip_body && AcceptsGzip(req[http::field::accept_encoding]);
+        const std::string& etag = use_gzip ? cached.gzip_etag : cached.etag;
+        const auto& body = use_gzip ? cached.gzip_body : cached.body;
 
-            response.body() = json::serialize(json::value(std::move(players_on_map_json)));
+        auto response = MakeResponse<SharedStringResponse>(req);
+        response.set(http::field::cache_control, "no-cache");
+        response.set(http::field::content_type, ContentType::APP_JSON);
+        response.set(http::field::etag, etag);
+        response.set(http::field::vary, "Accept-Encoding");
+        if (use_gzip) {
+            response.set(http::field::content_encoding, "gzip");
+        }
 
-            response.set(http::field::content_type, ContentType::APP_JSON);
-            response.content_length(response.body().size());
+        if (IsNotModified(req[http::field::if_none_match], etag)) {
+            response.result(http::status::not_modified);
+        } else {
             response.result(http::status::ok);
+            response.content_length(body->size());
+            if (req.method() != http::verb::head) {
+                response.body() = body;
+            }
+        }
+        send(response);
+    }
+
+    template <typename Request>
+    const CachedResponse* ProcessApiPlayers(Request& request, StringResponse& response,
+                                            const PublishedState& published) const {
+        const CachedResponse* players = nullptr;
+        ExecutePublished(request, response, published, [&players](const PublishedSession& session) {
+            players = &session.players;
         });
+        return players;
     }
 
     template <typename Request>
@@ -271,80 +401,133 @@ private:
         response.result(http::status::ok);
     }
 
+    /* ?since=<version> - только изменения после этой версии состояния, считаются на strand игры.
+       Полное состояние берется из опубликованного снимка.
+       nullptr, если запрос неверен или не авторизован: тогда в response уже записана ошибка
+     */
     template <typename Request>
-    void ProcessApiGameState(Request& request, StringResponse& response) {
-
-        ExecuteAuthorized(request, response, [self = shared_from_this(), &response](std::string_view token) {
-            const auto& dogs = self->app_.ListPlayers(token);
-
-            json::object game_state_json;
-            game_state_json["players"].emplace_object();
-
-            for (const auto& [id, dog] : dogs) {
-                const geom::Point2D& pos = dog->GetPosition();
-                const geom::Vec2D& speed = dog->GetSpeed();
-
-                game_state_json["players"].as_object().insert_or_assign(std::to_string(*id), json::object{
-                    {"pos", {pos.x, pos.y}},
-                    {"speed", {speed.x, speed.y}},
-                    {"dir", model::DirectionToString(dog->GetDirection())},
-                    {"score", dog->GetScore()}
-                });
+    const CachedResponse* ProcessApiGameState(Request& request, StringResponse& response,
+                                              const PublishedState& published) {
+        using namespace std::literals;
 
-                auto& player_obj = game_state_json["players"].as_object()[std::to_string(*id)].as_object();
-                auto& bag = player_obj["bag"].emplace_array();
-                for (const auto& loot : dog->GetBag()->GetAllLoot()) {
-                    bag.emplace_back(json::object{{"id", *loot.id},
-                        {"type", loot.type}});
+        std::optional<std::uint64_t> since;
+        std::string_view target = request.target();
+        if (size_t query_pos = target.find('?'); query_pos != std::string_view::npos) {
+            auto query = ParseQuery(target.substr(query_pos + 1));
+            if (auto it = query.find("since"s); it != query.end()) {
+                since = ParseStateVersion(it->second);
+                if (!since) {
+                    MakeErrorApiResponse(response, ErrorCode::invalid_argument, "Invalid since parameter"sv);
+                    return nullptr;
                 }
             }
+        }
 
-            game_state_json["lostObjects"].emplace_object();
-            for (const auto& [id, loot_ptr] : self->app_.GetPlayerGameSession(token)->GetAllLoot()) {
-                game_state_json["lostObjects"].as_object().insert_or_assign(std::to_string(*id), json::object{
-                    {"type", loot_ptr->type},
-                    {"pos", {loot_ptr->point.x, loot_ptr->point.y}}
-                });
-            }
+        const CachedResponse* state = nullptr;
+        if (since) {
+            ExecuteAuthorized(request, response, [this, &state, since](const user::Player& player) {
+                state = &state_cache_.GetDelta(player.GetGameSession(), *since);
+            });
+        } else {
+            ExecutePublished(request, response, published, [&state](const PublishedSession& session) {
+                state = &session.state;
+            });
+        }
+        return state;
+    }
 
-            response.body() = json::serialize(json::value(std::move(game_state_json)));
+    static std::optional<std::uint64_t> ParseStateVersion(std::string_view str);
 
-            response.set(http::field::content_type, ContentType::APP_JSON);
-            response.content_length(response.body().size());
-            response.result(http::status::ok);
-        });
-    }
+    // игрок, которому адресована команда: в модели при ручном тике, иначе в опубликованном снимке
+    struct MoveTarget {
+        user::Player* player = nullptr;
+        const PublishedPlayer* published = nullptr;
+
+        explicit operator bool() const noexcept {
+            return player != nullptr || published != nullptr;
+        }
+    };
+
+    // токен ищется один раз, дальше команда идет к найденному игроку
+    MoveTarget FindMoveTarget(std::string_view token, const PublishedState& published);
+    // в очередь сессии или, в режиме ручного тика, сразу в модель
+    MoveResult SubmitMove(const MoveTarget& target, const json::value& move);
 
     template <typename Request>
     void ProcessApiAction(Request& request, StringResponse& response) {
         using namespace std::literals;
 
-        ExecuteAuthorized(request, response,
-                          [self = shared_from_this(), &request, &response] (std::string_view token) {
+        try {
+            auto published = publisher_.Load();
+            const MoveTarget target = FindMoveTarget(GetRawTokenValue(request), *published);
+            if (!target) {
+                MakeErrorApiResponse(response, ErrorCode::unknown_token, "Player token has not been found"sv);
+                return;
+            }
 
             if (!request.count(http::field::content_type)) {
-                self->MakeErrorApiResponse(response, ErrorCode::invalid_argument,
-                                           "Invalid content type"sv);
+                MakeErrorApiResponse(response, ErrorCode::invalid_argument, "Invalid content type"sv);
                 return;
             }
 
             boost::system::error_code ec;
-
             json::value request_body = json::parse(request.body(), ec);
-            if (ec || !(request_body.if_object() && request_body.as_object().count("move"))
-                   || !self->app_.MoveDog(token, request_body.as_object().at("move").as_string())) {
-                self->MakeErrorApiResponse(response, ErrorCode::invalid_argument, "Failed to parse action"sv);
-                return;
+            const json::value* move = ec || !request_body.is_object() ? nullptr : request_body.as_object().if_contains("move");
+            switch (move ? SubmitMove(target, *move) : MoveResult::invalid_move) {
+                case MoveResult::ok:
+                    break;
+                case MoveResult::unknown_token:
+                    MakeErrorApiResponse(response, ErrorCode::unknown_token, "Player token has not been found"sv);
+                    return;
+                case MoveResult::invalid_move:
+                    MakeErrorApiResponse(response, ErrorCode::invalid_argument, "Failed to parse action"sv);
+                    return;
+                case MoveResult::queue_full:
+                    MakeErrorApiResponse(response, ErrorCode::service_unavailable, "Too many actions"sv);
+                    return;
             }
+        } catch (const ErrorCode ec) {
+            MakeTokenErrorApiResponse(response, ec);
+            return;
+        }
 
-            response.body() = "{}"sv;
+        response.body() = "{}"sv;
 
-            response.set(http::field::content_type, ContentType::APP_JSON);
-            response.content_length(response.body().size());
-            response.result(http::status::ok);
-        });
+        response.set(http::field::content_type, ContentType::APP_JSON);
+        response.content_length(response.body().size());
+        response.result(http::status::ok);
+    }
+
+    /* Команды нескольких игроков одним запросом: [{"token": "...", "move": "L"}, ...].
+       Ответ - массив в том же порядке: {} для принятой команды или ошибка этой команды
+     */
+    template <typename Request>
+    void ProcessApiActions(Request& request, StringResponse& response) {
+        using namespace std::literals;
+
+        if (!request.count(http::field::content_type)) {
+            MakeErrorApiResponse(response, ErrorCode::invalid_argument, "Invalid content type"sv);
+            return;
+        }
+
+        boost::system::error_code ec;
+        json::value request_body = json::parse(request.body(), ec);
+        if (ec || !request_body.is_array() || request_body.as_array().size() > MAX_BATCH_ACTIONS) {
+            MakeErrorApiResponse(response, ErrorCode::invalid_argument, "Failed to parse actions"sv);
+            return;
+        }
+
+        response.body() = RenderMoveResults(request_body.as_array(), *publisher_.Load());
+
+        response.set(http::field::content_type, ContentType::APP_JSON);
+        response.content_length(response.body().size());
+        response.result(http::status::ok);
     }
 
+    constexpr static size_t MAX_BATCH_ACTIONS = 1024;
+
+    std::string RenderMoveResults(const json::array& actions, const PublishedState& published);
+
     template <typename Request>
     void ProcessApiTick(Request& request, StringResponse& response) {
         using namespace std::literals;
@@ -366,7 +549,8 @@ private:
         }
 
         try {
-            app_.ProcessTick(request_body.as_object().at("timeDelta").as_int64());
+            auto report = app_.ProcessTick(request_body.as_object().at("timeDelta").as_int64());
+            LogTickReport(app_, report);
         } catch (const std::exception& e) {
             response.body() = "{\"message\":\""s + e.what() + "\"}"s;
         }
@@ -425,7 +609,7 @@ private:
 
     enum class ErrorCode {
         map_not_found, invalid_method_get_head, invalid_method_post,
-        invalid_argument, bad_request, invalid_token, unknown_token
+        invalid_argument, bad_request, invalid_token, unknown_token, service_unavailable
     };
 
     template <typename Request, typename Executor>
@@ -433,22 +617,45 @@ private:
         using namespace std::literals;
 
         try {
-            std::string_view token = GetRawTokenValue(request);
-            if (!app_.IsTokenValid(token)) {
+            const user::Player* player = app_.FindPlayer(GetRawTokenValue(request));
+            if (player == nullptr) {
                 MakeErrorApiResponse(response, ErrorCode::unknown_token, "Player token has not been found"sv);
                 return;
             }
-            executor(token);
+            executor(*player);
         } catch (const ErrorCode ec) {
-            switch (ec) {
-                case ErrorCode::invalid_token:
-                    MakeErrorApiResponse(response, ErrorCode::invalid_token, "Authorization header is required"sv);
-                    break;
-                default:
-                    MakeErrorApiResponse(response, ErrorCode::bad_request, "Unknown error code while getting raw token"sv);
-                    break;
+            MakeTokenErrorApiResponse(response, ec);
+        }
+    }
+
+    // как ExecuteAuthorized, но игрок ищется в опубликованном снимке и модель не трогается
+    template <typename Request, typename Reader>
+    void ExecutePublished(Request& request, StringResponse& response, const PublishedState& published,
+                          Reader&& reader) const {
+        using namespace std::literals;
+
+        try {
+            const PublishedSession* session = published.Find(GetRawTokenValue(request));
+            if (session == nullptr) {
+                MakeErrorApiResponse(response, ErrorCode::unknown_token, "Player token has not been found"sv);
+                return;
             }
-            return;
+            reader(*session);
+        } catch (const ErrorCode ec) {
+            MakeTokenErrorApiResponse(response, ec);
+        }
+    }
+
+    void MakeTokenErrorApiResponse(StringResponse& response, ErrorCode code) const {
+        using namespace std::literals;
+
+        switch (code) {
+            case ErrorCode::invalid_token:
+                MakeErrorApiResponse(response, ErrorCode::invalid_token, "Authorization header is required"sv);
+                break;
+            default:
+                MakeErrorApiResponse(response, ErrorCode::bad_request, "Unknown error code while getting raw token"sv);
+                break;
         }
     }
 
@@ -476,12 +683,15 @@ private:
 
     void MakeErrorApiResponse(StringResponse& response, ApiRequestHandler::ErrorCode code,
                               std::string_view message) const;
+    void MakeMethodErrorApiResponse(StringResponse& response, ApiEndpoint endpoint) const;
 };
 
 class StaticRequestHandler {
 public:
-    explicit StaticRequestHandler(std::filesystem::path&& static_files_path)
-    : static_files_path_(std::move(static_files_path)) {
+    explicit StaticRequestHandler(std::filesystem::path&& static_files_path, net::io_context& ioc)
+    : static_files_path_(std::move(static_files_path))
+    , cache_(std::make_shared<StaticFileCache>(static_files_path_, ioc)) {
+        cache_->Watch();
     }
 
     StaticRequestHandler(const StaticRequestHandler&) = delete;
@@ -499,18 +709,15 @@ public:
 
 private:
     std::filesystem::path static_files_path_;
+    std::shared_ptr<StaticFileCache> cache_;
 
     template <typename Request, typename Send>
     void SendStaticFile(Request&& req, Send&& send, std::string_view target) const {
-        FileResponse response;
-        FillBasicInfo(req, response);
-
-        http::status status{};
+        using namespace std::literals;
 
         switch (req.method()) {
             case http::verb::get:
             case http::verb::head:
-                status = ProcessStaticFileTarget(response, target);
                 break;
 
             default:
@@ -520,6 +727,31 @@ private:
                 return;
         }
 
+        const bool head = req.method() == http::verb::head;
+        target = target.substr(0, target.find('?'));
+        auto entry = cache_->Find(target == "/"sv || target.empty() ? "index.html"s : DecodeUri(target));
+
+        if (entry && entry->body) {
+            auto response = MakeResponse<SharedStringResponse>(req);
+            response.result(entry->header.result());
+            for (const auto& field : entry->header) {
+                response.set(field.name_string(), field.value());
+            }
+            if (IsNotModified(req[http::field::if_none_match], entry->header[http::field::etag])) {
+                response.result(http::status::not_modified);
+            } else if (!head) {
+                response.body() = entry->body;
+            }
+            send(response);
+            return;
+        }
+
+        // большие файлы и файлы, которых еще нет в снимке, идут с диска через sendfile
+        FileResponse response;
+        http::status status = entry ? OpenCachedFile(response, *entry, head)
+                                    : ProcessStaticFileTarget(response, target, head);
+        FillBasicInfo(req, response);
+
         if (status != http::status::ok) {
             auto error_response = MakeErrorStaticFileResponse(status);
             FillBasicInfo(req, error_response);
@@ -529,18 +761,27 @@ private:
         }
     }
 
-    http::status ProcessStaticFileTarget(FileResponse& response, std::string_view target) const;
+    http::status OpenCachedFile(FileResponse& response, const StaticFileCache::Entry& entry, bool head) const;
+    http::status ProcessStaticFileTarget(FileResponse& response, std::string_view target, bool head) const;
     StringResponse MakeErrorStaticFileResponse(http::status status) const;
 };
 
 class RequestHandler : public std::enable_shared_from_this<RequestHandler> {
 public:
+    // на ioc работает кеш статики; strand игры может жить на другом io_context
     explicit RequestHandler(app::Application& app, net::io_context& ioc, Strand& api_strand,
                             std::filesystem::path&& static_files_path, bool manual_update)
-        : ioc_(ioc)
+        : app_(app)
+        , ioc_(ioc)
         , api_strand_(api_strand)
-        , api_handler_(std::make_shared<ApiRequestHandler>(app, manual_update))
-        , static_handler_(std::move(fs::canonical(static_files_path))) {
+        , state_publisher_(std::make_shared<StatePublisher>(app, state_cache_))
+        , api_handler_(std::make_shared<ApiRequestHandler>(app, state_cache_, *state_publisher_, manual_update))
+        , static_handler_(std::move(fs::canonical(static_files_path)), ioc)
+        , state_broadcaster_(std::make_shared<StateBroadcaster>(app, state_cache_)) {
+        // игроки могли быть восстановлены из сохранения до запуска сервера
+        state_publisher_->Publish(true);
+        app.SetListener(state_publisher_.get());
+        app.SetListener(state_broadcaster_.get());
     }
 
     RequestHandler(const RequestHandler&) = delete;
@@ -551,10 +792,15 @@ public:
         using namespace std::literals;
 
         std::string_view target = req.target();
-        if (target.size() >= 4 && target.substr(0, 5) == "/api/"sv) {
+        if (target.size() >= 4 && target.substr(0, 5) == "/api/"sv
+            && (ApiRequestHandler::IsReadOnly(req) || api_handler_->IsQueuedAction(req))) {
+            (*api_handler_)(req, send);
+        } else if (target.size() >= 4 && target.substr(0, 5) == "/api/"sv) {
+            api_queue_depth_.fetch_add(1, std::memory_order_relaxed);
             net::dispatch(api_strand_, [self = shared_from_this(),
                                        req = std::forward<decltype(req)>(req),
                                        send = std::forward<Send>(send)]() {
+                self->api_queue_depth_.fetch_sub(1, std::memory_order_relaxed);
                 (*self->api_handler_)(req, send);
             });
         } else {
@@ -562,11 +808,25 @@ public:
         }
     }
 
+    // WebSocket upgrade: соединение переходит к StateSocket, HTTP-сессия его больше не обслуживает
+    void Upgrade(http_server::StringRequest&& req, beast::tcp_stream&& stream);
+
+    // сколько запросов ждут своей очереди на strand игры; можно читать из любого потока
+    std::size_t GetApiQueueDepth() const noexcept {
+        return api_queue_depth_.load(std::memory_order_relaxed);
+    }
+
 private:
+    app::Application& app_;
     net::io_context& ioc_;
     Strand& api_strand_;
+    // используется только на api_strand_, объявлен до обработчиков, которые его держат
+    StateSnapshotCache state_cache_;
+    std::shared_ptr<StatePublisher> state_publisher_;
     std::shared_ptr<ApiRequestHandler> api_handler_;
     StaticRequestHandler static_handler_;
+    std::shared_ptr<StateBroadcaster> state_broadcaster_;
+    std::atomic<std::size_t> api_queue_depth_{0};
 };
 
 }  // namespace http_handler
@@ -0,0 +1,126 @@
+#include "response_cache.h"
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <sstream>
+
+namespace http_handler {
+
+using namespace std::literals;
+
+namespace {
+
+std::string_view Trim(std::string_view str) {
+    while (!str.empty() && std::isspace(static_cast<unsigned char>(str.front()))) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && std::isspace(static_cast<unsigned char>(str.back()))) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+bool EqualsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+    return lhs.size() == rhs.size()
+        && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char l, char r) {
+               return std::tolower(static_cast<unsigned char>(l)) == std::tolower(static_cast<unsigned char>(r));
+           });
+}
+
+// вызывает fn для каждого элемента списка заголовка, разделенного запятыми
+template <typename Fn>
+bool AnyListItem(std::string_view list, Fn&& fn) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        if (fn(Trim(list.substr(0, comma)))) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+std::string_view StripWeakPrefix(std::string_view etag) {
+    if (etag.substr(0, 2) == "W/"sv) {
+        etag.remove_prefix(2);
+    }
+    return etag;
+}
+
+} // namespace
+
+CachedResponse MakeCachedResponse(std::string body, bool compress) {
+    CachedResponse response;
+    response.etag = MakeStrongETag(body);
+
+    if (compress) {
+        // у сжатого представления свой ETag: байты ответа другие
+        response.gzip_etag = response.etag;
+        response.gzip_etag.insert(response.gzip_etag.size() - 1, "-gz"sv);
+        response.gzip_body = std::make_shared<const std::string>(GzipCompress(body));
+    }
+
+    response.body = std::make_shared<const std::string>(std::move(body));
+    return response;
+}
+
+std::string GzipCompress(std::string_view data) {
+    namespace io = boost::iostreams;
+
+    std::string compressed;
+    {
+        io::filtering_ostream out;
+        out.push(io::gzip_compressor(io::gzip_params(io::gzip::best_compression)));
+        out.push(io::back_inserter(compressed));
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    } // деструктор потока дописывает хвост gzip
+    return compressed;
+}
+
+std::string MakeStrongETag(std::string_view data) {
+    // FNV-1a: значение не зависит от запуска, поэтому ETag переживает рестарт сервера
+    std::uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    std::ostringstream etag;
+    etag << '"' << std::hex << data.size() << '-' << std::setw(16) << std::setfill('0') << hash << '"';
+    return etag.str();
+}
+
+bool IsNotModified(std::string_view if_none_match, std::string_view etag) {
+    return AnyListItem(if_none_match, [etag = StripWeakPrefix(etag)](std::string_view item) {
+        return item == "*"sv || StripWeakPrefix(item) == etag;
+    });
+}
+
+bool AcceptsGzip(std::string_view accept_encoding) {
+    return AnyListItem(accept_encoding, [](std::string_view item) {
+        size_t params = item.find(';');
+        if (!EqualsIgnoreCase(Trim(item.substr(0, params)), "gzip"sv)) {
+            return false;
+        }
+        if (params == std::string_view::npos) {
+            return true;
+        }
+        // gzip;q=0 - клиент явно отказывается от сжатия
+        std::string_view q = Trim(item.substr(params + 1));
+        if (q.substr(0, 2) != "q="sv) {
+            return true;
+        }
+        q.remove_prefix(2);
+        return q.find_first_not_of("0."sv) != std::string_view::npos;
+    });
+}
+
+}  // namespace http_handler
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "arena_allocator.h"
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace http_handler {
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+/* Тело ответа, разделяющее неизменяемую строку между всеми ответами.
+   Копирования при отправке нет: writer отдает буфер прямо из строки
+ */
+struct SharedStringBody {
+    using value_type = std::shared_ptr<const std::string>;
+
+    static std::uint64_t size(const value_type& body) noexcept {
+        return body ? body->size() : 0;
+    }
+
+    class writer {
+    public:
+        using const_buffers_type = boost::asio::const_buffer;
+
+        template <bool isRequest, class Fields>
+        writer(const http::header<isRequest, Fields>&, const value_type& body)
+            : body_(body) {
+        }
+
+        void init(beast::error_code& ec) {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+            ec = {};
+            if (!body_ || body_->empty()) {
+                return boost::none;
+            }
+            return {{const_buffers_type{body_->data(), body_->size()}, false}};
+        }
+
+    private:
+        const value_type& body_;
+    };
+};
+
+using SharedStringResponse = http::response<SharedStringBody, http_server::ArenaFields>;
+
+// готовый ответ: тело, его gzip-вариант (если есть) и сильные ETag обоих представлений
+struct CachedResponse {
+    std::shared_ptr<const std::string> body;
+    std::shared_ptr<const std::string> gzip_body;
+    std::string etag;
+    std::string gzip_etag;
+};
+
+CachedResponse MakeCachedResponse(std::string body, bool compress = true);
+
+std::string GzipCompress(std::string_view data);
+// ETag в кавычках, вычисляется по содержимому тела
+std::string MakeStrongETag(std::string_view data);
+
+// true, если один из ETag в If-None-Match совпадает с etag (сравнение слабое, как требует RFC 9110)
+bool IsNotModified(std::string_view if_none_match, std::string_view etag);
+bool AcceptsGzip(std::string_view accept_encoding);
+
+}  // namespace http_handler
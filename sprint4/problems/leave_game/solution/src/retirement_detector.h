@@ -25,6 +25,9 @@ public:
 
     void OnTick(std::chrono::milliseconds delta) override;
     void OnJoin(std::string token, model::Dog* dog) override;
+    std::string_view GetName() const override {
+        return "retirement";
+    }
 
 private:
     std::uint64_t retirement_time_;
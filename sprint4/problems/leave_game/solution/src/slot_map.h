@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace util {
+
+/* SlotMap хранит значения плотным массивом и выдает на них стабильные handle.
+   Удаление - swap-remove за O(1): последний элемент переезжает на место удаленного.
+   Поколение слота растет при каждом удалении, поэтому старый handle
+   не может случайно указать на новое значение в том же слоте
+ */
+template <typename T>
+class SlotMap {
+public:
+    struct Handle {
+        std::uint32_t slot = 0;
+        std::uint32_t generation = 0;
+
+        auto operator<=>(const Handle&) const = default;
+    };
+
+    Handle Insert(T value) {
+        std::uint32_t slot;
+        if (!free_slots_.empty()) {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+        } else {
+            slot = static_cast<std::uint32_t>(slots_.size());
+            slots_.push_back({});
+        }
+
+        slots_[slot].dense_index = static_cast<std::uint32_t>(values_.size());
+        values_.push_back(std::move(value));
+        dense_to_slot_.push_back(slot);
+        return {slot, slots_[slot].generation};
+    }
+
+    bool Erase(Handle handle) {
+        if (!Contains(handle)) {
+            return false;
+        }
+
+        const std::uint32_t index = slots_[handle.slot].dense_index;
+        const std::uint32_t last = static_cast<std::uint32_t>(values_.size() - 1);
+        if (index != last) {
+            values_[index] = std::move(values_[last]);
+            dense_to_slot_[index] = dense_to_slot_[last];
+            slots_[dense_to_slot_[index]].dense_index = index;
+        }
+        values_.pop_back();
+        dense_to_slot_.pop_back();
+
+        ++slots_[handle.slot].generation;
+        free_slots_.push_back(handle.slot);
+        return true;
+    }
+
+    bool Contains(Handle handle) const noexcept {
+        return handle.slot < slots_.size() && slots_[handle.slot].generation == handle.generation;
+    }
+
+    T& Get(Handle handle) {
+        return values_[GetIndex(handle)];
+    }
+
+    const T& Get(Handle handle) const {
+        return values_[GetIndex(handle)];
+    }
+
+    size_t GetIndex(Handle handle) const {
+        if (!Contains(handle)) {
+            throw std::out_of_range("stale slot map handle");
+        }
+        return slots_[handle.slot].dense_index;
+    }
+
+    Handle GetHandle(size_t index) const {
+        const std::uint32_t slot = dense_to_slot_.at(index);
+        return {slot, slots_[slot].generation};
+    }
+
+    size_t Size() const noexcept {
+        return values_.size();
+    }
+
+    bool Empty() const noexcept {
+        return values_.empty();
+    }
+
+    // значения в плотном порядке, индексы меняются после Erase
+    const std::vector<T>& GetValues() const noexcept {
+        return values_;
+    }
+
+private:
+    struct Slot {
+        std::uint32_t dense_index = 0;
+        std::uint32_t generation = 0;
+    };
+
+    std::vector<T> values_;
+    std::vector<std::uint32_t> dense_to_slot_;
+    std::vector<Slot> slots_;
+    std::vector<std::uint32_t> free_slots_;
+};
+
+}  // namespace util
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+namespace util {
+
+/* Кольцо фиксированного размера для одного писателя и одного читателя. Писатель заполняет
+   ячейку на месте, без копирования и без выделения памяти; при заполненном кольце запись
+   не ждет читателя, а возвращает false. Каждая сторона держит копию чужого индекса
+   и перечитывает общий атомик, только когда копии не хватает
+ */
+template <typename T>
+class SpscRing {
+public:
+    // capacity округляется вверх до степени двойки
+    explicit SpscRing(std::size_t capacity)
+        : mask_(RoundUpToPowerOfTwo(capacity) - 1)
+        , cells_(std::make_unique<T[]>(mask_ + 1)) {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // только из потока-писателя; fill(T&) заполняет свободную ячейку
+    template <typename Fill>
+    bool TryPush(Fill&& fill) {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ > mask_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ > mask_) {
+                return false;
+            }
+        }
+        fill(cells_[tail & mask_]);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // только из потока-читателя: fn(const T&) для всего, что успел записать писатель
+    template <typename Fn>
+    std::size_t PopAll(Fn&& fn) {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        cached_tail_ = tail_.load(std::memory_order_acquire);
+        for (std::size_t pos = head; pos != cached_tail_; ++pos) {
+            fn(static_cast<const T&>(cells_[pos & mask_]));
+        }
+        head_.store(cached_tail_, std::memory_order_release);
+        return cached_tail_ - head;
+    }
+
+    std::size_t GetCapacity() const noexcept {
+        return mask_ + 1;
+    }
+
+private:
+    constexpr static std::size_t CACHE_LINE = 64;
+
+    static std::size_t RoundUpToPowerOfTwo(std::size_t capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("SpscRing capacity must be positive");
+        }
+        std::size_t result = 1;
+        while (result < capacity) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const std::size_t mask_;
+    std::unique_ptr<T[]> cells_;
+    // индексы писателя и читателя живут в разных строках кеша
+    alignas(CACHE_LINE) std::atomic<std::size_t> tail_{0};
+    std::size_t cached_head_ = 0;
+    alignas(CACHE_LINE) std::atomic<std::size_t> head_{0};
+    std::size_t cached_tail_ = 0;
+};
+
+}  // namespace util
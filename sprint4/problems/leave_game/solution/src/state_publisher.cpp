@@ -0,0 +1,85 @@
+#include "state_publisher.h"
+
+#include "request_handler.h"
+
+#include <atomic>
+
+namespace http_handler {
+
+const PublishedSession* PublishedState::Find(std::string_view token) const {
+    const PublishedPlayer* player = FindPlayer(token);
+    if (player == nullptr) {
+        return nullptr;
+    }
+    auto published = sessions_.find(player->session);
+    return published != sessions_.end() ? published->second.get() : nullptr;
+}
+
+const PublishedPlayer* PublishedState::FindPlayer(std::string_view token) const {
+    return sessions_by_token_->Find(token);
+}
+
+void StatePublisher::Publish(bool players_changed) {
+    if (players_changed || !sessions_by_token_) {
+        auto sessions_by_token = std::make_shared<PublishedState::SessionByToken>();
+        app_.ForEachPlayerSession([&sessions_by_token](std::string_view token, const model::GameSession* session,
+                                                       model::Dog::Id dog_id) {
+            if (auto key = util::TokenKey::Parse(token)) {
+                sessions_by_token->Insert(*key, PublishedPlayer{session, dog_id});
+            }
+        });
+        sessions_by_token_ = std::move(sessions_by_token);
+        players_generation_ = app_.GetPlayersGeneration();
+    }
+
+    // сессия рисуется заново, только если ее ревизия изменилась с прошлой публикации
+    PublishedState::Sessions sessions;
+    sessions_by_token_->ForEach([this, &sessions, players_changed](const util::TokenKey&, const PublishedPlayer& player) {
+        const model::GameSession* session = player.session;
+        if (sessions.contains(session)) {
+            return;
+        }
+        const std::uint64_t revision = session->GetRevision();
+        auto previous = sessions_.find(session);
+        if (previous != sessions_.end() && previous->second->revision == revision) {
+            sessions.emplace(session, previous->second);
+            return;
+        }
+
+        auto published = std::make_shared<PublishedSession>();
+        published->revision = revision;
+        published->state = state_cache_.GetSnapshot(session);
+        // команды не меняют состав сессии, список игроков можно взять из прошлой публикации
+        if (!players_changed && previous != sessions_.end()) {
+            published->players = previous->second->players;
+        } else {
+            published->players = MakeCachedResponse(RenderPlayers(*session), false);
+        }
+        sessions.emplace(session, std::move(published));
+    });
+    sessions_ = sessions;
+
+    std::atomic_store_explicit(&published_,
+                               std::make_shared<const PublishedState>(sessions_by_token_, std::move(sessions)),
+                               std::memory_order_release);
+}
+
+std::shared_ptr<const PublishedState> StatePublisher::Load() const noexcept {
+    return std::atomic_load_explicit(&published_, std::memory_order_acquire);
+}
+
+void StatePublisher::OnTickProcessed([[maybe_unused]] std::chrono::milliseconds delta) {
+    // обычный тик двигает собак, но не меняет состав игроков: индекс токенов и списки игроков
+    // строятся заново, только если кто-то ушел на пенсию или вошел
+    Publish(app_.GetPlayersGeneration() != players_generation_);
+}
+
+void StatePublisher::OnJoin([[maybe_unused]] std::string token, [[maybe_unused]] model::Dog* dog) {
+    Publish(true);
+}
+
+void StatePublisher::OnMove([[maybe_unused]] model::Dog* dog, [[maybe_unused]] std::string_view move) {
+    Publish(false);
+}
+
+}  // namespace http_handler
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "app.h"
+#include "model.h"
+#include "response_cache.h"
+#include "token_table.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http_handler {
+
+class StateSnapshotCache;
+
+// то, что запросы на чтение видят об одной сессии
+struct PublishedSession {
+    std::uint64_t revision = 0;
+    CachedResponse state;
+    CachedResponse players;
+};
+
+// игрок в индексе токенов: его сессия и собака, которой он управляет
+struct PublishedPlayer {
+    const model::GameSession* session = nullptr;
+    model::Dog::Id dog_id{0u};
+};
+
+/* Снимок для запросов на чтение. После публикации не меняется,
+   поэтому его можно читать из любого потока без блокировок
+ */
+class PublishedState {
+public:
+    // поиск по string_view из заголовка запроса без временной строки
+    using SessionByToken = util::TokenTable<PublishedPlayer>;
+    using Sessions = std::unordered_map<const model::GameSession*, std::shared_ptr<const PublishedSession>>;
+
+    PublishedState(std::shared_ptr<const SessionByToken> sessions_by_token, Sessions sessions)
+        : sessions_by_token_(std::move(sessions_by_token))
+        , sessions_(std::move(sessions)) {
+    }
+
+    // nullptr, если игрока с таким токеном нет
+    const PublishedSession* Find(std::string_view token) const;
+    const PublishedPlayer* FindPlayer(std::string_view token) const;
+
+private:
+    // индекс токенов меняется только при входе и выходе игроков, поэтому разделяется между снимками
+    std::shared_ptr<const SessionByToken> sessions_by_token_;
+    Sessions sessions_;
+};
+
+/* Публикует снимки по схеме RCU: на strand игры после каждого изменения модели
+   собирается новый снимок и атомарно подменяет указатель. Читатель держит свою версию,
+   пока не закончит ответ, и никогда не ждет strand
+ */
+class StatePublisher : public app::ApplicationListener {
+public:
+    StatePublisher(app::Application& app, StateSnapshotCache& state_cache)
+        : app_(app)
+        , state_cache_(state_cache) {
+    }
+
+    // только на strand игры. players_changed: игроки могли войти или выйти, индекс токенов строится заново
+    void Publish(bool players_changed);
+    // из любого потока
+    std::shared_ptr<const PublishedState> Load() const noexcept;
+
+    void OnTick(std::chrono::milliseconds delta) override {
+    }
+    void OnTickProcessed(std::chrono::milliseconds delta) override;
+    void OnJoin(std::string token, model::Dog* dog) override;
+    void OnMove(model::Dog* dog, std::string_view move) override;
+    std::string_view GetName() const override {
+        return "publication";
+    }
+
+private:
+    app::Application& app_;
+    StateSnapshotCache& state_cache_;
+
+    // последняя публикация, из нее переиспользуются неизменившиеся сессии
+    std::shared_ptr<const PublishedState::SessionByToken> sessions_by_token_;
+    // состав игроков, по которому построены индекс токенов и списки игроков
+    std::uint64_t players_generation_ = 0;
+    PublishedState::Sessions sessions_;
+
+    std::shared_ptr<const PublishedState> published_ = std::make_shared<const PublishedState>(
+        std::make_shared<const PublishedState::SessionByToken>(), PublishedState::Sessions{});
+};
+
+}  // namespace http_handler
@@ -0,0 +1,203 @@
+#include "state_socket.h"
+
+#include "http_server.h"
+#include "request_handler.h"
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/json.hpp>
+
+#include <algorithm>
+
+namespace http_handler {
+
+using namespace std::literals;
+namespace json = boost::json;
+
+StateSocket::StateSocket(beast::tcp_stream&& stream, ApiRequestHandler& api_handler, Strand& api_strand,
+                         std::string token)
+    : ws_(std::move(stream))
+    , api_handler_(api_handler)
+    , api_strand_(api_strand)
+    , token_(std::move(token)) {
+}
+
+void StateSocket::Accept(http_server::StringRequest&& request) {
+    auto safe_request = std::make_shared<http_server::StringRequest>(std::move(request));
+    net::dispatch(ws_.get_executor(), [self = shared_from_this(), safe_request] {
+        self->ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+        self->ws_.read_message_max(MAX_COMMAND_SIZE);
+        self->ws_.text(true);
+        self->ws_.async_accept(*safe_request, [self, safe_request](beast::error_code ec) {
+            self->OnAccept(ec);
+        });
+    });
+}
+
+void StateSocket::Reject(http::response<http::string_body, http_server::ArenaFields>&& response) {
+    auto safe_response = std::make_shared<http::response<http::string_body, http_server::ArenaFields>>(
+        std::move(response));
+    safe_response->keep_alive(false);
+    safe_response->prepare_payload();
+    net::dispatch(ws_.get_executor(), [self = shared_from_this(), safe_response] {
+        auto& stream = self->ws_.next_layer();
+        stream.expires_after(30s);
+        http::async_write(stream, *safe_response,
+                          [self, safe_response](beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+            if (ec) {
+                http_server::ReportError(ec, "websocket reject"sv);
+            }
+            self->ws_.next_layer().socket().shutdown(net::ip::tcp::socket::shutdown_send, ec);
+        });
+    });
+}
+
+void StateSocket::Push(Frame frame) {
+    if (!IsOpen()) {
+        return;
+    }
+    net::dispatch(ws_.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+        if (!self->IsOpen()) {
+            return;
+        }
+        if (self->writing_) {
+            // клиент не успевает: старый кадр уже не нужен, его заменяет свежий
+            if (self->pending_) {
+                ++self->dropped_frames_;
+            }
+            self->pending_ = std::move(frame);
+            return;
+        }
+        self->Write(std::move(frame));
+    });
+}
+
+void StateSocket::Close() {
+    net::dispatch(ws_.get_executor(), [self = shared_from_this()] {
+        if (!self->IsOpen()) {
+            return;
+        }
+        self->state_ = State::closed;
+        self->pending_.reset();
+        self->ws_.async_close(websocket::close_code::normal, [self](beast::error_code ec) {
+            if (ec) {
+                http_server::ReportError(ec, "websocket close"sv);
+            }
+        });
+    });
+}
+
+const std::string& StateSocket::GetToken() const noexcept {
+    return token_;
+}
+
+bool StateSocket::IsOpen() const noexcept {
+    return state_ == State::open;
+}
+
+bool StateSocket::IsClosed() const noexcept {
+    return state_ == State::closed;
+}
+
+std::uint64_t StateSocket::GetDroppedFrames() const noexcept {
+    return dropped_frames_;
+}
+
+void StateSocket::OnAccept(beast::error_code ec) {
+    if (ec) {
+        state_ = State::closed;
+        return http_server::ReportError(ec, "websocket accept"sv);
+    }
+    state_ = State::open;
+    Read();
+}
+
+void StateSocket::Read() {
+    ws_.async_read(buffer_, beast::bind_front_handler(&StateSocket::OnRead, shared_from_this()));
+}
+
+void StateSocket::OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read) {
+    if (ec) {
+        state_ = State::closed;
+        if (ec != websocket::error::closed && ec != net::error::operation_aborted) {
+            http_server::ReportError(ec, "websocket read"sv);
+        }
+        return;
+    }
+
+    HandleCommand(beast::buffers_to_string(buffer_.data()));
+    buffer_.consume(buffer_.size());
+    Read();
+}
+
+void StateSocket::Write(Frame frame) {
+    writing_ = std::move(frame);
+    ws_.async_write(net::buffer(*writing_), beast::bind_front_handler(&StateSocket::OnWrite, shared_from_this()));
+}
+
+void StateSocket::OnWrite(beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
+    writing_.reset();
+    if (ec) {
+        state_ = State::closed;
+        pending_.reset();
+        if (ec != websocket::error::closed && ec != net::error::operation_aborted) {
+            http_server::ReportError(ec, "websocket write"sv);
+        }
+        return;
+    }
+
+    if (pending_ && IsOpen()) {
+        Write(std::move(pending_));
+    }
+}
+
+void StateSocket::HandleCommand(std::string command) {
+    boost::system::error_code ec;
+    json::value value = json::parse(command, ec);
+    const json::object* object = ec ? nullptr : value.if_object();
+    if (!object || !object->contains("move")) {
+        return;
+    }
+
+    if (!api_handler_.IsManualUpdate()) {
+        /* команда встает в очередь сессии вместе с HTTP-командами и применяется в начале тика.
+           Игрока, который ушел, соединение закроет StateBroadcaster после тика
+         */
+        api_handler_.SubmitMove(token_, object->at("move"));
+        return;
+    }
+
+    // в режиме ручного тика команды выполняются на strand игры, как и HTTP-запросы к API
+    net::dispatch(api_strand_, [self = shared_from_this(), value = std::move(value)] {
+        using MoveResult = ApiRequestHandler::MoveResult;
+        if (self->api_handler_.SubmitMove(self->token_, value.as_object().at("move")) == MoveResult::unknown_token) {
+            // игрок покинул игру, пока команда шла по сети
+            self->Close();
+        }
+    });
+}
+
+void StateBroadcaster::Add(std::shared_ptr<StateSocket> socket) {
+    sockets_.push_back(std::move(socket));
+}
+
+void StateBroadcaster::OnTickProcessed([[maybe_unused]] std::chrono::milliseconds delta) {
+    // игрок мог уйти на этом тике: его соединение закрывается, остальные получают новый кадр
+    std::erase_if(sockets_, [this](const std::shared_ptr<StateSocket>& socket) {
+        if (socket->IsClosed()) {
+            return true;
+        }
+        if (!socket->IsOpen()) {
+            // handshake еще идет
+            return false;
+        }
+        const user::Player* player = app_.FindPlayer(socket->GetToken());
+        if (player == nullptr) {
+            socket->Close();
+            return true;
+        }
+        socket->Push(state_cache_.GetSnapshot(player->GetGameSession()).body);
+        return false;
+    });
+}
+
+}  // namespace http_handler
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "app.h"
+#include "arena_allocator.h"
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace http_handler {
+
+namespace net = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace websocket = beast::websocket;
+
+class ApiRequestHandler;
+class StateSnapshotCache;
+
+/* WebSocket игрока. Токен проверяется один раз при upgrade, дальше сервер после каждого тика
+   шлет кадр с состоянием сессии, а клиент присылает команды вида {"move": "L"}.
+   Кадры не копятся: если клиент не успевает читать, ждет отправки только самый свежий
+ */
+class StateSocket : public std::enable_shared_from_this<StateSocket> {
+public:
+    using Strand = net::strand<net::io_context::executor_type>;
+    using Frame = std::shared_ptr<const std::string>;
+
+    constexpr static std::size_t MAX_COMMAND_SIZE = 1024;
+
+    StateSocket(beast::tcp_stream&& stream, ApiRequestHandler& api_handler, Strand& api_strand, std::string token);
+
+    StateSocket(const StateSocket&) = delete;
+    StateSocket& operator=(const StateSocket&) = delete;
+
+    void Accept(http_server::StringRequest&& request);
+    // отвечает на upgrade обычным HTTP-ответом и закрывает соединение
+    void Reject(http::response<http::string_body, http_server::ArenaFields>&& response);
+    // Push и Close можно вызывать из любого потока
+    void Push(Frame frame);
+    void Close();
+
+    const std::string& GetToken() const noexcept;
+    bool IsOpen() const noexcept;
+    // соединение закрыто или не прошло handshake и кадров больше не примет
+    bool IsClosed() const noexcept;
+    std::uint64_t GetDroppedFrames() const noexcept;
+
+private:
+    enum class State {
+        accepting, open, closed
+    };
+
+    websocket::stream<beast::tcp_stream> ws_;
+    ApiRequestHandler& api_handler_;
+    Strand& api_strand_;
+    std::string token_;
+    beast::flat_buffer buffer_;
+
+    // меняются только на executor соединения
+    Frame writing_;
+    Frame pending_;
+
+    std::atomic<State> state_ = State::accepting;
+    std::atomic<std::uint64_t> dropped_frames_ = 0;
+
+    void OnAccept(beast::error_code ec);
+    void Read();
+    void OnRead(beast::error_code ec, std::size_t bytes_read);
+    void Write(Frame frame);
+    void OnWrite(beast::error_code ec, std::size_t bytes_written);
+    void HandleCommand(std::string command);
+};
+
+// рассылает кадры состояния всем открытым WebSocket после каждого тика, работает на strand игры
+class StateBroadcaster : public app::ApplicationListener {
+public:
+    StateBroadcaster(app::Application& app, StateSnapshotCache& state_cache)
+        : app_(app)
+        , state_cache_(state_cache) {
+    }
+
+    void Add(std::shared_ptr<StateSocket> socket);
+
+    void OnTick(std::chrono::milliseconds delta) override {
+    }
+    void OnTickProcessed(std::chrono::milliseconds delta) override;
+    std::string_view GetName() const override {
+        return "websocket";
+    }
+
+private:
+    app::Application& app_;
+    StateSnapshotCache& state_cache_;
+    std::vector<std::shared_ptr<StateSocket>> sockets_;
+};
+
+}  // namespace http_handler
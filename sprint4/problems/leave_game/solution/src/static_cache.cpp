@@ -0,0 +1,157 @@
+#include "static_cache.h"
+
+#include "logger.h"
+#include "request_handler.h"
+#include "response_cache.h"
+
+#include <sys/inotify.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace http_handler {
+
+using namespace std::literals;
+
+namespace {
+
+std::shared_ptr<const StaticFileCache::Entry> LoadEntry(const fs::path& path, std::uint64_t size,
+                                                        fs::file_time_type modified, bool in_memory) {
+    auto entry = std::make_shared<StaticFileCache::Entry>();
+    entry->path = path;
+    entry->size = size;
+    entry->modified = modified;
+
+    entry->header.result(http::status::ok);
+    entry->header.set(http::field::content_type, GetMimeType(GetFileExtention(path)));
+    entry->header.set(http::field::content_length, std::to_string(size));
+
+    if (in_memory) {
+        std::ifstream file{path, std::ios::binary};
+        if (!file) {
+            return nullptr;
+        }
+        std::string body{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        if (!file.good() && !file.eof()) {
+            return nullptr;
+        }
+        // файл мог измениться между stat и чтением: заголовок описывает то, что реально прочитано
+        entry->size = body.size();
+        entry->header.set(http::field::content_length, std::to_string(body.size()));
+        entry->header.set(http::field::etag, MakeStrongETag(body));
+        entry->body = std::make_shared<const std::string>(std::move(body));
+    }
+    return entry;
+}
+
+} // namespace
+
+StaticFileCache::StaticFileCache(fs::path root, net::io_context& ioc)
+    : root_(std::move(root))
+    , strand_(net::make_strand(ioc))
+    , inotify_(strand_)
+    , refresh_timer_(strand_) {
+    Refresh();
+}
+
+void StaticFileCache::Watch() {
+    const int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        http_logger::LogServerError(errno, std::strerror(errno), "static cache watch"sv);
+        return;
+    }
+    inotify_.assign(fd);
+    AddWatches();
+    ReadEvents();
+}
+
+std::shared_ptr<const StaticFileCache::Entry> StaticFileCache::Find(const std::string& path) const {
+    auto entries = std::atomic_load_explicit(&entries_, std::memory_order_acquire);
+    auto entry = entries->find(path);
+    return entry != entries->end() ? entry->second : nullptr;
+}
+
+void StaticFileCache::Refresh() {
+    const auto current = std::atomic_load_explicit(&entries_, std::memory_order_acquire);
+    auto entries = std::make_shared<Entries>();
+    std::uint64_t cached_size = 0;
+
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it{root_, fs::directory_options::skip_permission_denied, ec}, end;
+         !ec && it != end; it.increment(ec)) {
+        // по символическим ссылкам можно выйти за корень, такие файлы идут мимо кеша с проверкой пути
+        std::error_code file_ec;
+        if (it->is_symlink(file_ec) || !it->is_regular_file(file_ec)) {
+            continue;
+        }
+        const std::uint64_t size = it->file_size(file_ec);
+        const fs::file_time_type modified = it->last_write_time(file_ec);
+        if (file_ec) {
+            continue;
+        }
+
+        const bool in_memory = size <= MAX_CACHED_FILE_SIZE && cached_size + size <= MAX_CACHE_SIZE;
+        std::string key = it->path().lexically_relative(root_).generic_string();
+
+        std::shared_ptr<const Entry> entry;
+        if (auto old = current->find(key); old != current->end() && old->second->size == size
+            && old->second->modified == modified && static_cast<bool>(old->second->body) == in_memory) {
+            entry = old->second;
+        } else {
+            entry = LoadEntry(it->path(), size, modified, in_memory);
+        }
+        if (!entry) {
+            continue;
+        }
+        if (entry->body) {
+            cached_size += entry->size;
+        }
+        entries->emplace(std::move(key), std::move(entry));
+    }
+
+    std::atomic_store_explicit(&entries_, std::shared_ptr<const Entries>(std::move(entries)),
+                               std::memory_order_release);
+}
+
+void StaticFileCache::AddWatches() {
+    constexpr std::uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB
+                                 | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+    // повторный inotify_add_watch на тот же каталог безопасен, поэтому новые каталоги просто добавляются
+    ::inotify_add_watch(inotify_.native_handle(), root_.c_str(), mask);
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it{root_, fs::directory_options::skip_permission_denied, ec}, end;
+         !ec && it != end; it.increment(ec)) {
+        std::error_code dir_ec;
+        if (!it->is_symlink(dir_ec) && it->is_directory(dir_ec)) {
+            ::inotify_add_watch(inotify_.native_handle(), it->path().c_str(), mask);
+        }
+    }
+}
+
+void StaticFileCache::ReadEvents() {
+    inotify_.async_read_some(net::buffer(events_),
+                             [self = shared_from_this()](boost::system::error_code ec, std::size_t bytes_read) {
+        if (ec) {
+            if (ec != net::error::operation_aborted) {
+                http_logger::LogServerError(ec.value(), ec.message(), "static cache watch"sv);
+            }
+            return;
+        }
+
+        // какие именно файлы изменились, не важно: снимок пересобирается целиком, неизменные файлы не перечитываются
+        self->refresh_timer_.expires_after(REFRESH_DELAY);
+        self->refresh_timer_.async_wait([self](boost::system::error_code ec) {
+            if (!ec) {
+                self->Refresh();
+                self->AddWatches();
+            }
+        });
+        self->ReadEvents();
+    });
+}
+
+}  // namespace http_handler
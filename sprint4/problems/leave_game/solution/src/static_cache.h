@@ -0,0 +1,72 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/http/message.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http_handler {
+
+namespace net = boost::asio;
+namespace http = boost::beast::http;
+
+/* Снимок каталога статики в памяти. Небольшие файлы хранятся целиком вместе с готовым заголовком ответа,
+   большие только описаны: их содержимое отдается с диска через sendfile.
+   Снимок пересобирается по событиям inotify и читается из любого потока без блокировок
+ */
+class StaticFileCache : public std::enable_shared_from_this<StaticFileCache> {
+public:
+    constexpr static std::uint64_t MAX_CACHED_FILE_SIZE = 256 * 1024;
+    constexpr static std::uint64_t MAX_CACHE_SIZE = 64 * 1024 * 1024;
+    // пачка событий (например, копирование каталога) дает одну пересборку
+    constexpr static std::chrono::milliseconds REFRESH_DELAY{100};
+
+    struct Entry {
+        std::filesystem::path path;
+        std::uint64_t size = 0;
+        std::filesystem::file_time_type modified;
+        // nullptr - файл не поместился в кеш
+        std::shared_ptr<const std::string> body;
+        // Content-Type, Content-Length и ETag (только для файлов в памяти)
+        http::response_header<> header;
+    };
+
+    // root должен быть каноническим путем
+    StaticFileCache(std::filesystem::path root, net::io_context& ioc);
+
+    StaticFileCache(const StaticFileCache&) = delete;
+    StaticFileCache& operator=(const StaticFileCache&) = delete;
+
+    // начинает следить за каталогом; без inotify кеш работает, но не обновляется
+    void Watch();
+
+    // path - декодированный путь запроса относительно корня, например "js/app.js"
+    std::shared_ptr<const Entry> Find(const std::string& path) const;
+
+private:
+    using Entries = std::unordered_map<std::string, std::shared_ptr<const Entry>>;
+
+    std::filesystem::path root_;
+    std::shared_ptr<const Entries> entries_ = std::make_shared<const Entries>();
+
+    net::strand<net::io_context::executor_type> strand_;
+    net::posix::stream_descriptor inotify_;
+    net::steady_timer refresh_timer_;
+    std::array<char, 4096> events_;
+
+    void Refresh();
+    void AddWatches();
+    void ReadEvents();
+};
+
+}  // namespace http_handler
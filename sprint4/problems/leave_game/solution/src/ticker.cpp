@@ -1,5 +1,6 @@
 #include "ticker.h"
 
+#include <algorithm>
 #include <cassert>
 
 namespace tick {
@@ -9,10 +10,17 @@ using namespace std::chrono;
 void Ticker::Start() {
     net::dispatch(strand_, [self = shared_from_this()] {
         self->last_tick_ = steady_clock::now();
+        self->last_tick_ns_.store(self->last_tick_.time_since_epoch().count(), std::memory_order_relaxed);
         self->ScheduleTick();
     });
 }
 
+milliseconds Ticker::GetLag() const {
+    const Clock::time_point last_tick{Clock::duration{last_tick_ns_.load(std::memory_order_relaxed)}};
+    const auto late = duration_cast<milliseconds>(Clock::now() - last_tick) - period_;
+    return std::max(late, 0ms);
+}
+
 void Ticker::ScheduleTick() {
     timer_.expires_after(period_);
     timer_.async_wait([self = shared_from_this()](sys::error_code ec) {
@@ -25,6 +33,7 @@ void Ticker::OnTick(sys::error_code ec) {
         auto this_tick = steady_clock::now();
         auto delta = duration_cast<milliseconds>(this_tick - last_tick_);
         last_tick_ = this_tick;
+        last_tick_ns_.store(this_tick.time_since_epoch().count(), std::memory_order_relaxed);
         try {
             handler_(delta);
         } catch (...) {
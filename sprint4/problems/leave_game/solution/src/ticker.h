@@ -4,7 +4,9 @@
 #include <boost/asio/steady_timer.hpp>
 #include <boost/asio/strand.hpp>
 
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <memory>
 
 namespace tick {
@@ -20,11 +22,15 @@ public:
     Ticker(Strand& strand, std::chrono::milliseconds period, Handler handler)
         : strand_(strand)
         , period_(period)
-        , handler_(std::move(handler)) {
+        , handler_(std::move(handler))
+        , last_tick_ns_(Clock::now().time_since_epoch().count()) {
     }
 
     void Start();
 
+    // насколько очередной тик запаздывает против расписания; можно вызывать из любого потока
+    std::chrono::milliseconds GetLag() const;
+
 private:
     using Clock = std::chrono::steady_clock;
 
@@ -33,6 +39,8 @@ private:
     net::steady_timer timer_{strand_};
     Handler handler_;
     Clock::time_point last_tick_;
+    // копия last_tick_ для чтения из других потоков
+    std::atomic<Clock::rep> last_tick_ns_;
 
     void ScheduleTick();
     void OnTick(sys::error_code ec);
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+namespace detail {
+
+// значение шестнадцатеричной цифры по символу, -1 - не цифра; принимаются только строчные буквы
+constexpr std::array<std::int8_t, 256> HEX_VALUES = [] {
+    std::array<std::int8_t, 256> values{};
+    values.fill(-1);
+    for (int i = 0; i < 10; ++i) {
+        values['0' + i] = static_cast<std::int8_t>(i);
+    }
+    for (int i = 0; i < 6; ++i) {
+        values['a' + i] = static_cast<std::int8_t>(10 + i);
+    }
+    return values;
+}();
+
+// две цифры на байт: кодирование без деления и без потоков
+constexpr std::array<std::array<char, 2>, 256> HEX_BYTES = [] {
+    constexpr std::string_view digits = "0123456789abcdef";
+    std::array<std::array<char, 2>, 256> bytes{};
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+        bytes[i] = {digits[i >> 4], digits[i & 0xF]};
+    }
+    return bytes;
+}();
+
+}  // namespace detail
+
+// токен игрока: 128 бит, в текстовом виде - 32 шестнадцатеричные цифры в нижнем регистре
+struct TokenKey {
+    constexpr static std::size_t HEX_SIZE = 32;
+
+    std::uint64_t high = 0;
+    std::uint64_t low = 0;
+
+    auto operator<=>(const TokenKey&) const = default;
+
+    // nullopt, если строка - не 32 шестнадцатеричные цифры
+    static std::optional<TokenKey> Parse(std::string_view hex) noexcept {
+        if (hex.size() != HEX_SIZE) {
+            return std::nullopt;
+        }
+        TokenKey key;
+        if (!ParseHalf(hex.substr(0, HEX_SIZE / 2), key.high) || !ParseHalf(hex.substr(HEX_SIZE / 2), key.low)) {
+            return std::nullopt;
+        }
+        return key;
+    }
+
+    // пишет ровно HEX_SIZE символов
+    void Format(char* out) const noexcept {
+        FormatHalf(high, out);
+        FormatHalf(low, out + HEX_SIZE / 2);
+    }
+
+    std::string ToString() const {
+        std::string result(HEX_SIZE, '\0');
+        Format(result.data());
+        return result;
+    }
+
+private:
+    static bool ParseHalf(std::string_view hex, std::uint64_t& value) noexcept {
+        value = 0;
+        for (char c : hex) {
+            const std::int8_t digit = detail::HEX_VALUES[static_cast<unsigned char>(c)];
+            if (digit < 0) {
+                return false;
+            }
+            value = value << 4 | static_cast<std::uint64_t>(digit);
+        }
+        return true;
+    }
+
+    static void FormatHalf(std::uint64_t value, char* out) noexcept {
+        for (int byte = 7; byte >= 0; --byte) {
+            const auto& digits = detail::HEX_BYTES[value & 0xFF];
+            out[byte * 2] = digits[0];
+            out[byte * 2 + 1] = digits[1];
+            value >>= 8;
+        }
+    }
+};
+
+/* Таблица токенов с открытой адресацией: ключи и значения лежат в одном массиве,
+   коллизии разрешаются линейным пробированием, при удалении хвост цепочки сдвигается назад,
+   поэтому надгробий нет. Поиск по строке из запроса разбирает ее на месте и ничего не выделяет
+ */
+template <typename T>
+class TokenTable {
+public:
+    // nullptr, если токена нет или строка не похожа на токен
+    T* Find(std::string_view token) noexcept {
+        auto key = TokenKey::Parse(token);
+        return key ? Find(*key) : nullptr;
+    }
+
+    const T* Find(std::string_view token) const noexcept {
+        auto key = TokenKey::Parse(token);
+        return key ? Find(*key) : nullptr;
+    }
+
+    T* Find(const TokenKey& key) noexcept {
+        const std::size_t index = FindIndex(key);
+        return index != NPOS ? &slots_[index].value : nullptr;
+    }
+
+    const T* Find(const TokenKey& key) const noexcept {
+        const std::size_t index = FindIndex(key);
+        return index != NPOS ? &slots_[index].value : nullptr;
+    }
+
+    bool Contains(const TokenKey& key) const noexcept {
+        return FindIndex(key) != NPOS;
+    }
+
+    // false, если ключ уже есть: значение не меняется
+    bool Insert(const TokenKey& key, T value) {
+        if ((size_ + 1) * MAX_LOAD_DENOMINATOR > slots_.size() * MAX_LOAD_NUMERATOR) {
+            Grow();
+        }
+        std::size_t index = Home(key);
+        for (; slots_[index].occupied; index = (index + 1) & mask_) {
+            if (slots_[index].key == key) {
+                return false;
+            }
+        }
+        slots_[index] = Slot{key, std::move(value), true};
+        ++size_;
+        return true;
+    }
+
+    bool Erase(const TokenKey& key) {
+        std::size_t hole = FindIndex(key);
+        if (hole == NPOS) {
+            return false;
+        }
+        // элемент цепочки переезжает в дыру, если его домашняя ячейка не лежит между дырой и им самим
+        for (std::size_t next = (hole + 1) & mask_; slots_[next].occupied; next = (next + 1) & mask_) {
+            const std::size_t home = Home(slots_[next].key);
+            const bool home_in_gap = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+            if (!home_in_gap) {
+                slots_[hole] = std::move(slots_[next]);
+                hole = next;
+            }
+        }
+        slots_[hole] = Slot{};
+        --size_;
+        return true;
+    }
+
+    std::size_t Size() const noexcept {
+        return size_;
+    }
+
+    // fn(const TokenKey&, const T&) для каждой записи, порядок не определен
+    template <typename Fn>
+    void ForEach(Fn&& fn) const {
+        for (const Slot& slot : slots_) {
+            if (slot.occupied) {
+                fn(slot.key, slot.value);
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        TokenKey key;
+        T value{};
+        bool occupied = false;
+    };
+
+    constexpr static std::size_t NPOS = static_cast<std::size_t>(-1);
+    constexpr static std::size_t MIN_CAPACITY = 16;
+    // таблица растет, когда заполнена больше чем на 3/4
+    constexpr static std::size_t MAX_LOAD_NUMERATOR = 3;
+    constexpr static std::size_t MAX_LOAD_DENOMINATOR = 4;
+
+    std::vector<Slot> slots_;
+    std::size_t mask_ = 0;
+    std::size_t size_ = 0;
+
+    std::size_t Home(const TokenKey& key) const noexcept {
+        // токены случайны, но восстановленные из сохранения приходят извне, поэтому биты перемешиваются
+        std::uint64_t hash = key.low ^ (key.high * 0x9E3779B97F4A7C15ull);
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 33;
+        return static_cast<std::size_t>(hash) & mask_;
+    }
+
+    std::size_t FindIndex(const TokenKey& key) const noexcept {
+        if (slots_.empty()) {
+            return NPOS;
+        }
+        for (std::size_t index = Home(key); slots_[index].occupied; index = (index + 1) & mask_) {
+            if (slots_[index].key == key) {
+                return index;
+            }
+        }
+        return NPOS;
+    }
+
+    void Grow() {
+        std::vector<Slot> old = std::move(slots_);
+        const std::size_t capacity = old.empty() ? MIN_CAPACITY : old.size() * 2;
+        slots_ = std::vector<Slot>(capacity);
+        mask_ = capacity - 1;
+        size_ = 0;
+        for (Slot& slot : old) {
+            if (slot.occupied) {
+                Insert(slot.key, std::move(slot.value));
+            }
+        }
+    }
+};
+
+}  // namespace util
@@ -0,0 +1,78 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/api_router.h"
+
+#include <string_view>
+
+using namespace std::literals;
+namespace http = boost::beast::http;
+using http_handler::MethodMask;
+using http_handler::Route;
+using http_handler::RouteTable;
+
+namespace {
+
+enum class Endpoint {
+    list, item, item_tags, search
+};
+
+constexpr RouteTable ROUTES{std::array{
+    Route<Endpoint>{"/api/items", Endpoint::list, MethodMask{http::verb::get}},
+    Route<Endpoint>{"/api/items/{id}", Endpoint::item, MethodMask{http::verb::get, http::verb::head}},
+    Route<Endpoint>{"/api/items/{id}/tags/{tag}", Endpoint::item_tags, MethodMask{http::verb::post}},
+    Route<Endpoint>{"/api/items/search", Endpoint::search, MethodMask{http::verb::get}},
+}};
+
+// таблица строится и ищет на этапе компиляции
+static_assert(ROUTES.Find("/api/items"sv).route->endpoint == Endpoint::list);
+static_assert(!ROUTES.Find("/api/unknown"sv));
+
+} // namespace
+
+SCENARIO("Route table matches paths by segments") {
+    GIVEN("a table with static and parameter segments") {
+        WHEN("a path matches a static route") {
+            THEN("query string and trailing slash are ignored") {
+                CHECK(ROUTES.Find("/api/items?start=10"sv).route->endpoint == Endpoint::list);
+                CHECK(ROUTES.Find("/api/items/"sv).route->endpoint == Endpoint::list);
+            }
+        }
+
+        WHEN("a path has parameter segments") {
+            auto match = ROUTES.Find("/api/items/42/tags/red"sv);
+
+            THEN("parameters are captured in order") {
+                REQUIRE(match);
+                CHECK(match.route->endpoint == Endpoint::item_tags);
+                REQUIRE(match.params_count == 2);
+                CHECK(match.params[0] == "42"sv);
+                CHECK(match.params[1] == "red"sv);
+            }
+        }
+
+        WHEN("a static segment and a parameter compete") {
+            THEN("the static segment wins") {
+                CHECK(ROUTES.Find("/api/items/search"sv).route->endpoint == Endpoint::search);
+                CHECK(ROUTES.Find("/api/items/searches"sv).route->endpoint == Endpoint::item);
+            }
+        }
+
+        WHEN("a path is only a prefix of a route or goes past it") {
+            THEN("nothing matches") {
+                CHECK_FALSE(ROUTES.Find("/api"sv));
+                CHECK_FALSE(ROUTES.Find("/api/items/42/tags"sv));
+                CHECK_FALSE(ROUTES.Find("/api/itemsXYZ"sv));
+                CHECK_FALSE(ROUTES.Find("/api/items//tags/red"sv));
+                CHECK_FALSE(ROUTES.Find("api/items"sv));
+            }
+        }
+
+        WHEN("a route is found") {
+            THEN("its method mask is kept") {
+                const auto& methods = ROUTES.Find("/api/items/1"sv).route->methods;
+                CHECK(methods.Contains(http::verb::head));
+                CHECK_FALSE(methods.Contains(http::verb::post));
+            }
+        }
+    }
+}
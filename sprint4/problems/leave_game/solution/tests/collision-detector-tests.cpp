@@ -7,6 +7,7 @@
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 
 #include <algorithm>
+#include <random>
 #include <sstream>
 #include <vector>
 // Напишите здесь тесты для функции collision_detector::FindGatherEvents
@@ -262,3 +263,35 @@ TEST_CASE("FindGatherEvents test case", "[gather events]") {
         }
     }
 }
+
+TEST_CASE("FindGatherEvents matches brute force", "[gather events]") {
+    std::mt19937 generator{7};
+    std::uniform_real_distribution<double> coord(0., 30.);
+    std::uniform_real_distribution<double> step(-3., 3.);
+
+    for (int round = 0; round < 50; ++round) {
+        TestItemGathererProvider provider;
+        for (int i = 0; i < 100; ++i) {
+            provider.AddItem({{coord(generator), coord(generator)}, i % 5 == 0 ? 0.5 : 0.});
+        }
+        for (int g = 0; g < 40; ++g) {
+            geom::Point2D start{coord(generator), coord(generator)};
+            geom::Point2D end = start;
+            (g % 2 == 0 ? end.x : end.y) += step(generator);
+            provider.AddGatherer({start, end, 0.6});
+        }
+        // собиратель, который проходит через все поле за один тик
+        provider.AddGatherer({{-1., 15.}, {31., 15.}, 0.6});
+
+        const auto events = FindGatherEvents(provider);
+        const auto brute_force_events = FindGatherEventsBruteForce(provider);
+
+        REQUIRE(events.size() == brute_force_events.size());
+        for (size_t i = 0; i < events.size(); ++i) {
+            CHECK(events[i].item_id == brute_force_events[i].item_id);
+            CHECK(events[i].gatherer_id == brute_force_events[i].gatherer_id);
+            CHECK(events[i].sq_distance == brute_force_events[i].sq_distance);
+            CHECK(events[i].time == brute_force_events[i].time);
+        }
+    }
+}
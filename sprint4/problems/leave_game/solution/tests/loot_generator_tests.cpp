@@ -143,5 +143,31 @@ SCENARIO("Loot generation on map") {
                 }
             }
         }
+
+        WHEN("two games run with the same random seed") {
+            Game other_game = json_loader::LoadGame("../../tests/test_config.json");
+            for (Game* g : {&game, &other_game}) {
+                g->SetRandomSeed(42);
+                g->TurnOnRandomSpawn();
+                g->SetLootConfig(1., 1.);
+            }
+
+            auto& session = game.StartGameSession(game.FindMap(Map::Id{"map1"s}));
+            auto& other_session = other_game.StartGameSession(other_game.FindMap(Map::Id{"map1"s}));
+            for (int i = 0; i < 5; ++i) {
+                session.AddDog("dog"sv);
+                other_session.AddDog("dog"sv);
+                session.UpdateState(1000);
+                other_session.UpdateState(1000);
+            }
+
+            THEN("dogs spawn and loot appears at the same places") {
+                REQUIRE(session.GetAllLoot().size() == 5);
+                CHECK(session.GetAllLoot() == other_session.GetAllLoot());
+                for (const auto& [id, dog] : session.GetDogs()) {
+                    CHECK(dog->GetPosition() == other_session.GetDog(id)->GetPosition());
+                }
+            }
+        }
     }
 }
@@ -0,0 +1,196 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <chrono>
+#include <stdexcept>
+
+#include "../src/model.h"
+
+using namespace model;
+using namespace std::literals;
+
+SCENARIO("Collinear roads are merged into corridors") {
+    GIVEN("a row of roads added out of order: [0, 10], [20, 30], then [10, 20] between them") {
+        Map map{Map::Id{"map"s}, "Map"s};
+        map.AddRoad({Road::HORIZONTAL, {0, 0}, 10});
+        map.AddRoad({Road::HORIZONTAL, {30, 0}, 20});
+        map.AddRoad({Road::HORIZONTAL, {10, 0}, 20});
+
+        WHEN("a dog runs east past the joints") {
+            const RoadMove move = map.MoveAlongRoads({2, 0}, {27, 0}, Direction::EAST);
+
+            THEN("it passes through both joints in one move") {
+                CHECK(move.position == geom::Point2D{27, 0});
+                CHECK_FALSE(move.stopped);
+            }
+        }
+
+        WHEN("a dog runs east beyond the last road") {
+            const RoadMove move = map.MoveAlongRoads({2, 0.3}, {45, 0.3}, Direction::EAST);
+
+            THEN("it stops at the edge of the merged corridor and keeps its offset across the road") {
+                CHECK(move.position == geom::Point2D{30 + Road::HALF_WIDTH, 0.3});
+                CHECK(move.stopped);
+            }
+        }
+
+        WHEN("a dog runs west beyond the first road") {
+            const RoadMove move = map.MoveAlongRoads({25, 0}, {-5, 0}, Direction::WEST);
+
+            THEN("it stops at the other edge of the corridor") {
+                CHECK(move.position == geom::Point2D{-Road::HALF_WIDTH, 0});
+                CHECK(move.stopped);
+            }
+        }
+    }
+
+    GIVEN("two overlapping roads and a third one separated by a gap") {
+        Map map{Map::Id{"map"s}, "Map"s};
+        map.AddRoad({Road::VERTICAL, {0, 0}, 10});
+        map.AddRoad({Road::VERTICAL, {0, 15}, 5});
+        map.AddRoad({Road::VERTICAL, {0, 17}, 25});
+
+        WHEN("a dog runs south towards the gap") {
+            const RoadMove move = map.MoveAlongRoads({0, 1}, {0, 20}, Direction::SOUTH);
+
+            THEN("the overlapping roads form one corridor and the gap stops the dog") {
+                CHECK(move.position == geom::Point2D{0, 15 + Road::HALF_WIDTH});
+                CHECK(move.stopped);
+            }
+        }
+
+        WHEN("a dog on the separate road runs north") {
+            const RoadMove move = map.MoveAlongRoads({0, 24}, {0, 10}, Direction::NORTH);
+
+            THEN("it stops at the start of its own corridor") {
+                CHECK(move.position == geom::Point2D{0, 17 - Road::HALF_WIDTH});
+                CHECK(move.stopped);
+            }
+        }
+    }
+}
+
+SCENARIO("Dogs move along road corridors") {
+    GIVEN("a horizontal road [0, 20] crossed by a vertical road [0, 10] at x = 5") {
+        Map map{Map::Id{"map"s}, "Map"s};
+        map.AddRoad({Road::HORIZONTAL, {0, 0}, 20});
+        map.AddRoad({Road::VERTICAL, {5, 0}, 10});
+
+        WHEN("a dog moves within the road") {
+            const RoadMove move = map.MoveAlongRoads({1, 0}, {4, 0}, Direction::EAST);
+
+            THEN("it reaches the target") {
+                CHECK(move.position == geom::Point2D{4, 0});
+                CHECK_FALSE(move.stopped);
+            }
+        }
+
+        WHEN("a dog on the vertical road runs east") {
+            const RoadMove move = map.MoveAlongRoads({5, 8}, {9, 8}, Direction::EAST);
+
+            THEN("it moves only within the width of the vertical road") {
+                CHECK(move.position == geom::Point2D{5 + Road::HALF_WIDTH, 8});
+                CHECK(move.stopped);
+            }
+        }
+
+        WHEN("a dog at the crossing runs north") {
+            const RoadMove move = map.MoveAlongRoads({5, 0}, {5, -3}, Direction::NORTH);
+
+            THEN("it stops at the edge of the horizontal road") {
+                CHECK(move.position == geom::Point2D{5, -Road::HALF_WIDTH});
+                CHECK(move.stopped);
+            }
+        }
+
+        WHEN("a dog at the crossing runs south") {
+            const RoadMove move = map.MoveAlongRoads({5, 0}, {5, 12}, Direction::SOUTH);
+
+            THEN("it follows the vertical road to its end") {
+                CHECK(move.position == geom::Point2D{5, 10 + Road::HALF_WIDTH});
+                CHECK(move.stopped);
+            }
+        }
+
+        WHEN("a dog is off the roads") {
+            THEN("its move is rejected") {
+                CHECK_THROWS_AS(map.MoveAlongRoads({15, 5}, {16, 5}, Direction::EAST), std::logic_error);
+            }
+        }
+    }
+}
+
+SCENARIO("Fixed timestep splits and caps tick deltas") {
+    using namespace std::chrono_literals;
+    using Catch::Matchers::WithinAbs;
+
+    GIVEN("a game where a dog runs east at 1 unit per second, steps of 100 ms and at most 300 ms per tick") {
+        Map map{Map::Id{"map"s}, "Map"s};
+        map.AddRoad({Road::HORIZONTAL, {0, 0}, 100});
+        Game game;
+        game.AddMap(std::move(map));
+        game.SetFixedTimestep(100, 300);
+        GameSession& session = game.StartGameSession(game.FindMap(Map::Id{"map"s}));
+        Dog* dog = session.AddDog("dog"sv);
+        dog->Move(Direction::EAST, 1.);
+        const std::uint64_t start_version = session.GetStateVersion();
+
+        WHEN("a 250 ms tick is processed") {
+            const TickReport report = game.UpdateState(250);
+
+            THEN("it is simulated in steps of 100, 100 and 50 ms") {
+                CHECK(report.steps == 3);
+                CHECK(session.GetStateVersion() == start_version + 3);
+                CHECK(report.simulated == 250ms);
+                CHECK_THAT(dog->GetPosition().x, WithinAbs(0.25, 1e-9));
+                // последний шаг начался в 0.2
+                CHECK_THAT(dog->GetPreviousPosition().x, WithinAbs(0.2, 1e-9));
+            }
+
+            THEN("no time is dropped") {
+                CHECK(game.ClampTickDelta(250) == 250);
+                CHECK(report.dropped == 0ms);
+                CHECK(report.total_dropped == 0ms);
+            }
+        }
+
+        WHEN("a 1000 ms tick is processed") {
+            const TickReport report = game.UpdateState(1000);
+
+            THEN("only the catch-up limit is simulated, in whole steps") {
+                CHECK(game.ClampTickDelta(1000) == 300);
+                CHECK(report.simulated == 300ms);
+                CHECK(report.steps == 3);
+                CHECK_THAT(dog->GetPosition().x, WithinAbs(0.3, 1e-9));
+            }
+
+            THEN("the rest is reported as dropped") {
+                CHECK(report.dropped == 700ms);
+                CHECK(report.total_dropped == 700ms);
+            }
+
+            AND_WHEN("another late tick is processed") {
+                const TickReport next_report = game.UpdateState(500);
+
+                THEN("the dropped time adds up since start") {
+                    CHECK(next_report.dropped == 200ms);
+                    CHECK(next_report.total_dropped == 900ms);
+                    CHECK(game.GetDroppedTime() == 900ms);
+                }
+            }
+        }
+
+        WHEN("both limits are turned off") {
+            game.SetFixedTimestep(0, 0);
+            const TickReport report = game.UpdateState(1000);
+
+            THEN("the whole delta is simulated in one step") {
+                CHECK(game.ClampTickDelta(1000) == 1000);
+                CHECK(report.steps == 1);
+                CHECK(report.simulated == 1000ms);
+                CHECK(report.dropped == 0ms);
+                CHECK_THAT(dog->GetPosition().x, WithinAbs(1., 1e-9));
+            }
+        }
+    }
+}
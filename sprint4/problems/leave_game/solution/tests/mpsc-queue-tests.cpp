@@ -0,0 +1,77 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/mpsc_queue.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+SCENARIO("MpscQueue is a bounded FIFO") {
+    GIVEN("a queue with capacity rounded up to a power of two") {
+        util::MpscQueue<int> queue{3};
+        REQUIRE(queue.GetCapacity() == 4);
+
+        WHEN("it is filled up") {
+            for (int i = 0; i < 4; ++i) {
+                REQUIRE(queue.TryPush(i));
+            }
+
+            THEN("further pushes fail instead of blocking") {
+                CHECK_FALSE(queue.TryPush(4));
+            }
+
+            THEN("values come out in push order and free their cells") {
+                int value = -1;
+                for (int i = 0; i < 4; ++i) {
+                    REQUIRE(queue.TryPop(value));
+                    CHECK(value == i);
+                }
+                CHECK_FALSE(queue.TryPop(value));
+                CHECK(queue.TryPush(5));
+            }
+        }
+    }
+}
+
+SCENARIO("MpscQueue delivers every value from concurrent producers") {
+    GIVEN("several producers and one consumer") {
+        constexpr int PRODUCERS = 4;
+        constexpr std::uint32_t PER_PRODUCER = 100'000;
+        util::MpscQueue<std::uint64_t> queue{256};
+
+        std::vector<std::thread> producers;
+        for (std::uint64_t producer = 0; producer < PRODUCERS; ++producer) {
+            producers.emplace_back([&queue, producer] {
+                for (std::uint32_t i = 0; i < PER_PRODUCER; ++i) {
+                    while (!queue.TryPush(producer << 32 | i)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        WHEN("the consumer drains the queue") {
+            std::vector<std::uint32_t> next(PRODUCERS, 0);
+            bool in_order = true;
+            for (std::uint64_t received = 0; received < PRODUCERS * PER_PRODUCER;) {
+                std::uint64_t value = 0;
+                if (!queue.TryPop(value)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                auto& expected = next[value >> 32];
+                in_order = in_order && (value & 0xFFFFFFFF) == expected;
+                ++expected;
+                ++received;
+            }
+            for (auto& producer : producers) {
+                producer.join();
+            }
+
+            THEN("each producer's values arrive once and in its order") {
+                CHECK(in_order);
+                CHECK(next == std::vector<std::uint32_t>(PRODUCERS, PER_PRODUCER));
+            }
+        }
+    }
+}
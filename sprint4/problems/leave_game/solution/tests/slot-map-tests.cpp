@@ -0,0 +1,55 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/slot_map.h"
+
+#include <string>
+
+using namespace std::literals;
+
+SCENARIO("SlotMap keeps handles stable under swap-remove") {
+    GIVEN("a slot map with three values") {
+        util::SlotMap<std::string> slot_map;
+        auto first = slot_map.Insert("first"s);
+        auto second = slot_map.Insert("second"s);
+        auto third = slot_map.Insert("third"s);
+        REQUIRE(slot_map.Size() == 3);
+
+        WHEN("a value in the middle is erased") {
+            REQUIRE(slot_map.Erase(second));
+
+            THEN("the last value takes its dense place and keeps its handle") {
+                CHECK(slot_map.Size() == 2);
+                CHECK(slot_map.GetValues() == std::vector{"first"s, "third"s});
+                CHECK(slot_map.Get(first) == "first"s);
+                CHECK(slot_map.Get(third) == "third"s);
+                CHECK(slot_map.GetIndex(third) == 1);
+                CHECK(slot_map.GetHandle(1) == third);
+            }
+
+            THEN("the erased handle is stale") {
+                CHECK_FALSE(slot_map.Contains(second));
+                CHECK_FALSE(slot_map.Erase(second));
+                CHECK_THROWS_AS(slot_map.Get(second), std::out_of_range);
+            }
+
+            AND_WHEN("a new value reuses the freed slot") {
+                auto fourth = slot_map.Insert("fourth"s);
+
+                THEN("the old handle still does not match it") {
+                    CHECK(fourth.slot == second.slot);
+                    CHECK_FALSE(slot_map.Contains(second));
+                    CHECK(slot_map.Get(fourth) == "fourth"s);
+                }
+            }
+        }
+
+        WHEN("the last value is erased") {
+            REQUIRE(slot_map.Erase(third));
+
+            THEN("other values stay in place") {
+                CHECK(slot_map.GetValues() == std::vector{"first"s, "second"s});
+                CHECK(slot_map.GetIndex(second) == 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/spsc_ring.h"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+SCENARIO("SpscRing is a bounded FIFO filled in place") {
+    GIVEN("a ring with capacity rounded up to a power of two") {
+        util::SpscRing<int> ring{3};
+        REQUIRE(ring.GetCapacity() == 4);
+
+        WHEN("it is filled up") {
+            for (int i = 0; i < 4; ++i) {
+                REQUIRE(ring.TryPush([i](int& cell) {
+                    cell = i;
+                }));
+            }
+
+            THEN("further pushes fail and leave the cell untouched") {
+                bool filled = false;
+                CHECK_FALSE(ring.TryPush([&filled](int&) {
+                    filled = true;
+                }));
+                CHECK_FALSE(filled);
+            }
+
+            THEN("values come out in push order and free the ring") {
+                std::vector<int> values;
+                CHECK(ring.PopAll([&values](int value) {
+                    values.push_back(value);
+                }) == 4);
+                CHECK(values == std::vector<int>{0, 1, 2, 3});
+                CHECK(ring.PopAll([](int) {}) == 0);
+                CHECK(ring.TryPush([](int& cell) {
+                    cell = 4;
+                }));
+            }
+        }
+    }
+}
+
+SCENARIO("SpscRing hands every value from the writer thread to the reader") {
+    GIVEN("a writer that retries while the ring is full") {
+        constexpr std::uint64_t COUNT = 1'000'000;
+        util::SpscRing<std::uint64_t> ring{64};
+
+        std::thread writer{[&ring] {
+            for (std::uint64_t i = 0; i < COUNT; ++i) {
+                while (!ring.TryPush([i](std::uint64_t& cell) {
+                    cell = i;
+                })) {
+                    std::this_thread::yield();
+                }
+            }
+        }};
+
+        WHEN("the reader drains it") {
+            std::uint64_t expected = 0;
+            bool in_order = true;
+            while (expected < COUNT) {
+                ring.PopAll([&](std::uint64_t value) {
+                    in_order = in_order && value == expected;
+                    ++expected;
+                });
+            }
+            writer.join();
+
+            THEN("values arrive once and in order") {
+                CHECK(in_order);
+                CHECK(expected == COUNT);
+            }
+        }
+    }
+}
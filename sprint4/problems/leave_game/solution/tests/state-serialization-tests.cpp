@@ -1,9 +1,16 @@
+#include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_contains.hpp>
 #include <catch2/matchers/catch_matchers_predicate.hpp>
+#include <filesystem>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "../src/json_loader.h"
 #include "../src/model.h"
@@ -163,6 +170,7 @@ IsPermutationMatcher<Range> IsPermutation(Range&& range) {
 namespace user {
 bool operator==(const Player& lhs, const Player& rhs) {
     return lhs.GetGameSession()->GetMapId() == rhs.GetGameSession()->GetMapId() &&
+    lhs.GetGameSession()->GetId() == rhs.GetGameSession()->GetId() &&
     lhs.GetDog()->GetId() == rhs.GetDog()->GetId();
 }
 } //namespace user
@@ -201,7 +209,9 @@ SCENARIO_METHOD(Fixture, "Game and App Serialization") {
                 };
 
                 CHECK_THAT(game_session.GetDogs(), IsPermutation(restored->GetDogs(), map_sh_ptr_predicate));
-                CHECK_THAT(game_session.GetAllLoot(), IsPermutation(restored->GetAllLoot(), map_sh_ptr_predicate));
+                CHECK_THAT(game_session.GetAllLoot(), IsPermutation(restored->GetAllLoot(), [] (const auto& lhs, const auto& rhs) {
+                    return lhs == rhs;
+                }));
                 CHECK(game_session.GetNextDogId() == restored->GetNextDogId());
                 CHECK(game_session.GetNextLootId() == restored->GetNextLootId());
             }
@@ -265,11 +275,11 @@ SCENARIO_METHOD(Fixture, "Game and App Serialization") {
                         return *lhs == *rhs;
 
                     }));
-                    CHECK(*restored.FindByDogIdAndMapId(dog1->GetId(), gs1->GetMapId()) ==
-                          *players.FindByDogIdAndMapId(dog1->GetId(), gs1->GetMapId()));
+                    CHECK(*restored.FindByDogIdAndSessionId(dog1->GetId(), gs1->GetId()) ==
+                          *players.FindByDogIdAndSessionId(dog1->GetId(), gs1->GetId()));
 
-                    CHECK(*restored.FindByDogIdAndMapId(dog2->GetId(), Map::Id{"map3"s}) ==
-                          *players.FindByDogIdAndMapId(dog2->GetId(), Map::Id{"map3"s}));
+                    CHECK(*restored.FindByDogIdAndSessionId(dog2->GetId(), gs2->GetId()) ==
+                          *players.FindByDogIdAndSessionId(dog2->GetId(), gs2->GetId()));
                 }
             }
 
@@ -290,9 +300,9 @@ SCENARIO_METHOD(Fixture, "Game and App Serialization") {
                         input_archive >> repr;
                         user::PlayerTokens restored = repr.Restore(&players);
 
-                        CHECK(*player_tokens.FindPlayerByToken(token1) == *restored.FindPlayerByToken(token1));
-                        CHECK(*player_tokens.FindPlayerByToken(token2) == *restored.FindPlayerByToken(token2));
-                        CHECK(player_tokens.FindPlayerByToken(user::Token{"rand"}) == restored.FindPlayerByToken(user::Token{"rand"}));
+                        CHECK(*player_tokens.FindPlayerByToken(*token1) == *restored.FindPlayerByToken(*token1));
+                        CHECK(*player_tokens.FindPlayerByToken(*token2) == *restored.FindPlayerByToken(*token2));
+                        CHECK(player_tokens.FindPlayerByToken("rand"sv) == restored.FindPlayerByToken("rand"sv));
                     }
                 }
             }
@@ -327,3 +337,308 @@ SCENARIO_METHOD(Fixture, "Game and App Serialization") {
     }
 }
 
+SCENARIO_METHOD(Fixture, "Sharded sessions serialization") {
+    GIVEN("a game with at most 2 players per session and 5 players on one map") {
+        Game game = json_loader::LoadGame("../../tests/test_config.json"s);
+        game.SetMaxPlayersPerSession(2);
+        app::Application app(&game);
+
+        std::vector<app::JoinGameResult> join_results;
+        for (int i = 0; i < 5; ++i) {
+            join_results.push_back(app.JoinGame("dog"s + std::to_string(i), "map1"s));
+        }
+
+        THEN("players are spread over the least loaded sessions") {
+            const auto& map_sessions = game.GetAllSessions().at(Map::Id{"map1"s});
+            REQUIRE(map_sessions.size() == 3);
+            CHECK(map_sessions[0]->GetDogsCount() == 2);
+            CHECK(map_sessions[1]->GetDogsCount() == 2);
+            CHECK(map_sessions[2]->GetDogsCount() == 1);
+            CHECK(map_sessions[0]->GetId() != map_sessions[1]->GetId());
+        }
+
+        WHEN("a player leaves a full session") {
+            app.DeletePlayer(*join_results[0].token);
+
+            THEN("the next player joins the least loaded session") {
+                auto join_res = app.JoinGame("late_dog"s, "map1"s);
+                const auto* session = app.GetPlayerGameSession(*join_res.token);
+                CHECK(session->GetDogsCount() == 2);
+                CHECK(game.GetAllSessions().at(Map::Id{"map1"s}).size() == 3);
+            }
+        }
+
+        WHEN("the app is serialized") {
+            {
+                serialization::ApplicationRepr app_repr(app);
+                output_archive << app_repr;
+            }
+
+            THEN("every player is restored into the same session") {
+                InputArchive input_archive{strm};
+                serialization::ApplicationRepr repr;
+                input_archive >> repr;
+
+                model::Game new_game = json_loader::LoadGame("../../tests/test_config.json"s);
+                app::Application restored{&new_game};
+                repr.Restore(&restored);
+
+                for (const auto& join_res : join_results) {
+                    const auto* session = app.GetPlayerGameSession(*join_res.token);
+                    const auto* restored_session = restored.GetPlayerGameSession(*join_res.token);
+                    CHECK(session->GetId() == restored_session->GetId());
+                    CHECK(session->GetDogsCount() == restored_session->GetDogsCount());
+                }
+            }
+        }
+    }
+}
+
+SCENARIO_METHOD(Fixture, "State version serialization") {
+    GIVEN("a session that has been updated several times") {
+        Game game = json_loader::LoadGame("../../tests/test_config.json"s);
+        auto& session = game.StartGameSession(game.FindMap(Map::Id{"map1"s}));
+        Dog* dog = session.AddDog("dog"sv);
+        for (int i = 0; i < 3; ++i) {
+            game.UpdateState(10);
+        }
+        const std::uint64_t version = session.GetStateVersion();
+        REQUIRE(version == 3);
+
+        THEN("only dogs changed after the requested version are in the delta") {
+            CHECK(session.GetStateDelta(version).changed_dogs.empty());
+            dog->SetSpeed({1., 0});
+            auto delta = session.GetStateDelta(version);
+            CHECK_FALSE(delta.full);
+            REQUIRE(delta.changed_dogs.size() == 1);
+            CHECK(delta.changed_dogs.front() == dog);
+        }
+
+        WHEN("the game is serialized") {
+            {
+                serialization::GameRepr repr(game);
+                output_archive << repr;
+            }
+
+            THEN("the restored session keeps its version, but not the history") {
+                InputArchive input_archive{strm};
+                serialization::GameRepr repr;
+                input_archive >> repr;
+
+                Game restored = json_loader::LoadGame("../../tests/test_config.json"s);
+                repr.Restore(&restored);
+                const auto* restored_session = restored.GetGameSession(Map::Id{"map1"s});
+                CHECK(restored_session->GetStateVersion() == version);
+                CHECK_FALSE(restored_session->GetStateDelta(version).full);
+                CHECK(restored_session->GetStateDelta(version - 1).full);
+            }
+        }
+    }
+}
+
+namespace {
+
+// раскладка сохранения до версий классов: одна сессия на карту, без id сессий и версии состояния
+struct LegacySessionRepr {
+    std::string map_id;
+    std::vector<serialization::DogRepr> dogs;
+    std::uint32_t next_dog_id = 0;
+    std::vector<std::shared_ptr<Loot>> loot;
+    std::uint32_t next_loot_id = 0;
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& map_id;
+        ar& dogs;
+        ar& next_dog_id;
+        ar& loot;
+        ar& next_loot_id;
+    }
+};
+
+struct LegacyGameRepr {
+    std::vector<LegacySessionRepr> sessions;
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& sessions;
+    }
+};
+
+struct LegacyPlayerRepr {
+    std::string map_id;
+    std::uint32_t dog_id = 0;
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& map_id;
+        ar& dog_id;
+    }
+};
+
+struct LegacyPlayersRepr {
+    std::vector<LegacyPlayerRepr> players;
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& players;
+    }
+};
+
+struct LegacyPlayerTokenRepr {
+    std::unordered_map<std::string, LegacyPlayerRepr> token_to_player;
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& token_to_player;
+    }
+};
+
+struct LegacyApplicationRepr {
+    LegacyPlayersRepr players;
+    LegacyPlayerTokenRepr player_tokens;
+    LegacyGameRepr game;
+
+    template <typename Archive>
+    void serialize(Archive& ar, [[maybe_unused]] const unsigned version) {
+        ar& players;
+        ar& player_tokens;
+        ar& game;
+    }
+};
+
+}  // namespace
+
+SCENARIO_METHOD(Fixture, "Loading a save without class versions") {
+    GIVEN("a save of the one-session-per-map layout with two players and a loot") {
+        Game game = json_loader::LoadGame("../../tests/test_config.json"s);
+        game.SetLootConfig(1., 1.);
+        app::Application app(&game);
+        auto join_res_dog1 = app.JoinGame("dog1"s, "map1"s);
+        auto join_res_dog2 = app.JoinGame("dog2"s, "map3"s);
+        game.UpdateState(1000);
+
+        LegacyApplicationRepr legacy;
+        size_t loot_count = 0;
+        for (const auto& [map_id, sessions] : game.GetAllSessions()) {
+            for (const auto& session : sessions) {
+                LegacySessionRepr& session_repr = legacy.game.sessions.emplace_back();
+                session_repr.map_id = *map_id;
+                for (const auto& [_, dog] : session->GetDogs()) {
+                    session_repr.dogs.emplace_back(*dog);
+                }
+                session_repr.next_dog_id = session->GetNextDogId();
+                for (const Loot& loot : session->GetAllLoot()) {
+                    session_repr.loot.push_back(std::make_shared<Loot>(loot));
+                }
+                loot_count += session->GetAllLoot().size();
+                session_repr.next_loot_id = session->GetNextLootId();
+            }
+        }
+        for (const auto& [join_res, map_id] : {std::pair{join_res_dog1, "map1"s}, std::pair{join_res_dog2, "map3"s}}) {
+            LegacyPlayerRepr player{map_id, *join_res.player_id};
+            legacy.players.players.push_back(player);
+            legacy.player_tokens.token_to_player.emplace(*join_res.token, player);
+        }
+        REQUIRE(loot_count > 0);
+
+        WHEN("it is loaded") {
+            output_archive << legacy;
+
+            InputArchive input_archive{strm};
+            serialization::ApplicationRepr repr;
+            input_archive >> repr;
+
+            model::Game new_game = json_loader::LoadGame("../../tests/test_config.json"s);
+            app::Application restored{&new_game};
+            repr.Restore(&restored);
+
+            THEN("players are restored into the session of their map") {
+                const auto* session1 = restored.GetPlayerGameSession(*join_res_dog1.token);
+                const auto* session2 = restored.GetPlayerGameSession(*join_res_dog2.token);
+                REQUIRE(session1 != nullptr);
+                REQUIRE(session2 != nullptr);
+                CHECK(session1->GetMapId() == Map::Id{"map1"s});
+                CHECK(session2->GetMapId() == Map::Id{"map3"s});
+                CHECK(session1->GetId() != session2->GetId());
+                CHECK(session1->GetDog(join_res_dog1.player_id) != nullptr);
+            }
+
+            THEN("sessions keep their loot and start from state version 0") {
+                size_t restored_loot_count = 0;
+                for (const auto& [_, sessions] : new_game.GetAllSessions()) {
+                    for (const auto& session : sessions) {
+                        CHECK(session->GetStateVersion() == 0);
+                        restored_loot_count += session->GetAllLoot().size();
+                    }
+                }
+                CHECK(restored_loot_count == loot_count);
+            }
+        }
+    }
+}
+
+SCENARIO("Background state save") {
+    GIVEN("a listener that saves an app with two players in the background every 100 ms") {
+        Game game = json_loader::LoadGame("../../tests/test_config.json"s);
+        app::Application app(&game);
+        auto join_res_dog1 = app.JoinGame("dog1"s, "map1"s);
+        auto join_res_dog2 = app.JoinGame("dog2"s, "map2"s);
+
+        const auto state_dir = std::filesystem::temp_directory_path() / "game_server_background_save";
+        std::filesystem::remove_all(state_dir);
+        const auto state_file = state_dir / "state.bin";
+
+        std::mutex reports_mutex;
+        std::vector<serialization::SaveReport> reports;
+        {
+            serialization::SerializationListener listener{100ms, &app, state_file, true};
+            listener.SetReportHandler([&](const serialization::SaveReport& report) {
+                std::lock_guard lock{reports_mutex};
+                reports.push_back(report);
+            });
+
+            WHEN("ticks pass the save period and the server saves on exit") {
+                listener.OnTick(50ms);
+                listener.OnTick(50ms);
+                listener.Serialize();
+
+                THEN("the background save finishes first and both saves are reported") {
+                    std::lock_guard lock{reports_mutex};
+                    REQUIRE(reports.size() == 2);
+                    CHECK(reports[0].background);
+                    CHECK(reports[0].error.empty());
+                    CHECK(reports[0].bytes > 0);
+                    CHECK(reports[0].stall <= reports[0].duration);
+                    CHECK_FALSE(reports[1].background);
+                    CHECK(reports[1].stall == reports[1].duration);
+                    CHECK(reports[1].bytes == std::filesystem::file_size(state_file));
+                }
+
+                THEN("the saved state restores the players") {
+                    std::ifstream strm{state_file, strm.binary};
+                    boost::archive::binary_iarchive input_archive{strm};
+                    serialization::ApplicationRepr repr;
+                    input_archive >> repr;
+
+                    model::Game new_game = json_loader::LoadGame("../../tests/test_config.json"s);
+                    app::Application restored{&new_game};
+                    repr.Restore(&restored);
+                    CHECK(restored.GetPlayerGameSession(*join_res_dog1.token)->GetMap()->GetId() == Map::Id{"map1"s});
+                    CHECK(restored.GetPlayerGameSession(*join_res_dog2.token)->GetMap()->GetId() == Map::Id{"map2"s});
+                }
+            }
+
+            WHEN("ticks do not reach the save period") {
+                listener.OnTick(99ms);
+
+                THEN("nothing is saved") {
+                    std::lock_guard lock{reports_mutex};
+                    CHECK(reports.empty());
+                    CHECK_FALSE(std::filesystem::exists(state_file));
+                }
+            }
+        }
+        std::filesystem::remove_all(state_dir);
+    }
+}
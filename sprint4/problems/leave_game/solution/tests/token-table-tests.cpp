@@ -0,0 +1,101 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "../src/token_table.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std::literals;
+
+SCENARIO("TokenKey round-trips through its hex form") {
+    GIVEN("a token string") {
+        const auto hex = "0123456789abcdeffedcba9876543210"s;
+
+        WHEN("it is parsed") {
+            auto key = util::TokenKey::Parse(hex);
+
+            THEN("both halves are read and formatting restores the string") {
+                REQUIRE(key);
+                CHECK(key->high == 0x0123456789abcdefull);
+                CHECK(key->low == 0xfedcba9876543210ull);
+                CHECK(key->ToString() == hex);
+            }
+        }
+    }
+
+    GIVEN("strings that are not tokens") {
+        THEN("they are rejected") {
+            CHECK_FALSE(util::TokenKey::Parse(""sv));
+            CHECK_FALSE(util::TokenKey::Parse("0123456789abcdef"sv));
+            CHECK_FALSE(util::TokenKey::Parse("0123456789abcdeffedcba98765432100"sv));
+            CHECK_FALSE(util::TokenKey::Parse("0123456789ABCDEFfedcba9876543210"sv));
+            CHECK_FALSE(util::TokenKey::Parse("0123456789abcdeffedcba987654321g"sv));
+        }
+    }
+}
+
+SCENARIO("TokenTable finds, inserts and erases tokens") {
+    GIVEN("a table filled with many random tokens") {
+        std::mt19937_64 random{42};
+        std::vector<util::TokenKey> keys;
+        util::TokenTable<int> table;
+        for (int i = 0; i < 1000; ++i) {
+            util::TokenKey key{random(), random()};
+            keys.push_back(key);
+            REQUIRE(table.Insert(key, i));
+        }
+        REQUIRE(table.Size() == keys.size());
+
+        THEN("each token is found by key and by its string") {
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                REQUIRE(table.Find(keys[i]));
+                CHECK(*table.Find(keys[i]) == static_cast<int>(i));
+                CHECK(table.Find(keys[i].ToString()) == table.Find(keys[i]));
+            }
+            CHECK_FALSE(table.Find("not a token"sv));
+        }
+
+        THEN("a duplicate insert keeps the old value") {
+            CHECK_FALSE(table.Insert(keys[0], -1));
+            CHECK(*table.Find(keys[0]) == 0);
+        }
+
+        WHEN("every other token is erased") {
+            for (std::size_t i = 0; i < keys.size(); i += 2) {
+                REQUIRE(table.Erase(keys[i]));
+            }
+
+            THEN("the rest are still reachable through shifted chains") {
+                CHECK(table.Size() == keys.size() / 2);
+                for (std::size_t i = 0; i < keys.size(); ++i) {
+                    CHECK(table.Contains(keys[i]) == (i % 2 == 1));
+                }
+                CHECK_FALSE(table.Erase(keys[0]));
+            }
+        }
+    }
+
+    GIVEN("a small table with collision chains") {
+        util::TokenTable<int> table;
+        std::vector<util::TokenKey> keys;
+        for (std::uint64_t i = 0; i < 8; ++i) {
+            keys.push_back(util::TokenKey{0, i});
+            table.Insert(keys.back(), static_cast<int>(i));
+        }
+
+        WHEN("they are erased in insertion order") {
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                REQUIRE(table.Erase(keys[i]));
+                for (std::size_t j = i + 1; j < keys.size(); ++j) {
+                    REQUIRE(table.Find(keys[j]));
+                    CHECK(*table.Find(keys[j]) == static_cast<int>(j));
+                }
+            }
+
+            THEN("the table is empty") {
+                CHECK(table.Size() == 0);
+            }
+        }
+    }
+}